@@ -126,4 +126,11 @@ if(GIT_FOUND)
         OUTPUT_VARIABLE GIT_COMMIT_HASH
         OUTPUT_STRIP_TRAILING_WHITESPACE
     )
+    # chiplet follows a branch, its commit identifies the decompiler in the librarian cache
+    execute_process(
+        COMMAND ${GIT_EXECUTABLE} rev-parse --short HEAD
+        WORKING_DIRECTORY ${chiplet_SOURCE_DIR}
+        OUTPUT_VARIABLE CHIPLET_COMMIT_HASH
+        OUTPUT_STRIP_TRAILING_WHITESPACE
+    )
 endif()
@@ -1,5 +1,5 @@
 //---------------------------------------------------------------------------------------
-// src/emulation/c8capturehost.cpp
+// src/c8capturehost.cpp
 //---------------------------------------------------------------------------------------
 //
 // Copyright (c) 2023, Steffen Schümann <s.schuemann@pobox.com>
@@ -27,25 +27,23 @@
 #include <c8capturehost.hpp>
 #include <emulation/ichip8.hpp>
 
+static constexpr uint32_t BLACK_PIXEL = 0xff000000;  // RGBA in memory order, like raylib images
+
 C8CaptureHost::C8CaptureHost()
+: _snapshot(SNAPSHOT_WIDTH * SNAPSHOT_HEIGHT, BLACK_PIXEL)
+, _nineSnapshot(SHEET_WIDTH * SHEET_HEIGHT, BLACK_PIXEL)
 {
-    _snapshot = GenImageColor(128, 64, BLACK);
-    _nineSnapshot = GenImageColor(128*3, 64*3, BLACK);
 }
 
-C8CaptureHost::~C8CaptureHost()
-{
-    UnloadImage(_nineSnapshot);
-    UnloadImage(_snapshot);
-}
+C8CaptureHost::~C8CaptureHost() = default;
 
 void C8CaptureHost::preClear()
 {
     if(_snapNum < 2) {
-        grabImage((uint32_t*)_snapshot.data, _snapshot.width, _snapshot.height, _snapshot.width);
+        grabImage(_snapshot.data(), SNAPSHOT_WIDTH, SNAPSHOT_HEIGHT, SNAPSHOT_WIDTH);
     }
     if(_snapNum < 9) {
-        grabImage((uint32_t*)_snapshot.data + (_snapNum/3)*64*_nineSnapshot.width + (_snapNum%3)*128, 128, 64, _nineSnapshot.width);
+        grabImage(_nineSnapshot.data() + (_snapNum / 3) * SNAPSHOT_HEIGHT * SHEET_WIDTH + (_snapNum % 3) * SNAPSHOT_WIDTH, SNAPSHOT_WIDTH, SNAPSHOT_HEIGHT, SHEET_WIDTH);
     }
     _snapNum++;
 }
@@ -1,5 +1,5 @@
 //---------------------------------------------------------------------------------------
-// src/emulation/c8capturehost.hpp
+// src/c8capturehost.hpp
 //---------------------------------------------------------------------------------------
 //
 // Copyright (c) 2023, Steffen Schümann <s.schuemann@pobox.com>
@@ -27,19 +27,34 @@
 
 #include <chip8emuhostex.hpp>
 
-#include <raylib.h>
-
+#include <cstdint>
+#include <vector>
 
+//---------------------------------------------------------------------------------------
+// Headless host that grabs the screen right before it gets cleared, the first nine of
+// those grabs are scaled to 128x64 and tiled into a 3x3 sheet of the ROM's screens.
+// It needs no window or GPU, so many of them can run on worker threads.
+//---------------------------------------------------------------------------------------
 class C8CaptureHost : public emu::Chip8HeadlessHost
 {
 public:
+    static constexpr int SNAPSHOT_WIDTH = 128;
+    static constexpr int SNAPSHOT_HEIGHT = 64;
+    static constexpr int SHEET_WIDTH = SNAPSHOT_WIDTH * 3;
+    static constexpr int SHEET_HEIGHT = SNAPSHOT_HEIGHT * 3;
     C8CaptureHost();
     ~C8CaptureHost() override;
     void preClear() override;
 
+    int numSnapshots() const { return _snapNum; }
+    // RGBA pixels of the screen before the second clear, SNAPSHOT_WIDTH x SNAPSHOT_HEIGHT
+    const std::vector<uint32_t>& snapshot() const { return _snapshot; }
+    // RGBA pixels of the first nine screens in rows of three, SHEET_WIDTH x SHEET_HEIGHT
+    const std::vector<uint32_t>& nineSnapshot() const { return _nineSnapshot; }
+
 private:
     void grabImage(uint32_t* destination, int destWidth, int destHeight, int destStride);
-    Image _snapshot;
-    Image _nineSnapshot;
+    std::vector<uint32_t> _snapshot;
+    std::vector<uint32_t> _nineSnapshot;
     int _snapNum{0};
 };
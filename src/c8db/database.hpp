@@ -25,10 +25,13 @@
 //---------------------------------------------------------------------------------------
 #pragma once
 
+#include <algorithm>
 #include <cstdint>
+#include <cstring>
 #include <stdexcept>
 #include <fstream>
 #include <map>
+#include <memory>
 #include <optional>
 #include <string>
 #include <sstream>
@@ -38,6 +41,7 @@
 #include <iostream>
 
 #include <nlohmann/json.hpp>
+#include <sha1digest.hpp>
 
 namespace c8db {
 using json = nlohmann::json;
@@ -258,9 +262,109 @@ public:
         });
     }
 
-    size_t numRoms() const { return romLookupTable.size(); }
+    //-----------------------------------------------------------------------------------
+    // Compiled index: a header, the binary SHA1 digests of all roms sorted for a binary
+    // search, each with the number of its program, a table of program records and a pool
+    // of MessagePack blobs these point to. It is used as is after loading, the platforms
+    // are decoded right away, programs only when they are looked up.
+    //-----------------------------------------------------------------------------------
+    static constexpr uint32_t INDEX_MAGIC = 0x42443843;  // "C8DB"
+    static constexpr uint32_t INDEX_VERSION = 1;
+    static constexpr size_t INDEX_HEADER_SIZE = 32;
+    static constexpr size_t INDEX_ROM_ENTRY_SIZE = 24;
+    static constexpr size_t INDEX_PROGRAM_ENTRY_SIZE = 8;
+
+    // Loads a database from an index written by compile(), throws std::runtime_error if
+    // the file can't be read or is no valid index
+    static Database fromIndex(const std::string& indexFile)
+    {
+        Database db;
+        std::ifstream ifs(indexFile, std::ios::binary | std::ios::ate);
+        if(ifs.fail())
+            throw std::runtime_error("Could not open database index: " + indexFile);
+        db.indexData.resize(size_t(ifs.tellg()));
+        ifs.seekg(0, std::ios::beg);
+        if(!ifs.read((char*)db.indexData.data(), std::streamsize(db.indexData.size())) || db.indexData.size() < INDEX_HEADER_SIZE)
+            throw std::runtime_error("Could not read database index: " + indexFile);
+        if(db.indexWord(0) != INDEX_MAGIC || db.indexWord(4) != INDEX_VERSION)
+            throw std::runtime_error("Not a database index or wrong version: " + indexFile);
+        db.indexRoms = db.indexWord(8);
+        db.indexPrograms = db.indexWord(12);
+        db.indexProgramTable = INDEX_HEADER_SIZE + size_t(db.indexRoms) * INDEX_ROM_ENTRY_SIZE;
+        auto platformsOffset = db.indexWord(16), platformsSize = db.indexWord(20);
+        db.indexPool = db.indexWord(24);
+        if(db.indexProgramTable + size_t(db.indexPrograms) * INDEX_PROGRAM_ENTRY_SIZE > db.indexPool || db.indexPool > db.indexData.size() || size_t(platformsOffset) + platformsSize > db.indexData.size() - db.indexPool)
+            throw std::runtime_error("Corrupt database index: " + indexFile);
+        auto platformsObj = json::from_msgpack(db.indexData.begin() + db.indexPool + platformsOffset, db.indexData.begin() + db.indexPool + platformsOffset + platformsSize);
+        for(const auto& pObj : platformsObj) {
+            Platform p;
+            from_json(pObj, p);
+            db.platformList.push_back(p);
+        }
+        db.programCache.resize(db.indexPrograms);
+        return db;
+    }
+
+    // Writes the compiled index of this database, see fromIndex()
+    bool compile(const std::string& indexFile)
+    {
+        std::vector<std::pair<Sha1Digest, uint32_t>> roms;
+        std::vector<uint8_t> pool;
+        std::vector<uint8_t> programTable;
+        auto platformsObj = json::array();
+        for(const auto& platform : platformList)
+            platformsObj.push_back(platform);
+        json::to_msgpack(platformsObj, pool);
+        auto platformsSize = uint32_t(pool.size());
+        const auto& allPrograms = programs();
+        for(uint32_t i = 0; i < allPrograms.size(); ++i) {
+            nlohmann::ordered_json obj;
+            to_json_ordered(obj, allPrograms[i]);
+            auto offset = uint32_t(pool.size());
+            nlohmann::ordered_json::to_msgpack(obj, pool);
+            putWord(programTable, offset);
+            putWord(programTable, uint32_t(pool.size()) - offset);
+            for(const auto& [sha, rom] : allPrograms[i].roms) {
+                auto digest = Sha1Digest::fromHex(sha);
+                if(!digest.isZero())
+                    roms.emplace_back(digest, i);
+            }
+        }
+        std::sort(roms.begin(), roms.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+        std::vector<uint8_t> data;
+        putWord(data, INDEX_MAGIC);
+        putWord(data, INDEX_VERSION);
+        putWord(data, uint32_t(roms.size()));
+        putWord(data, uint32_t(allPrograms.size()));
+        putWord(data, 0);  // platforms are the first blob in the pool
+        putWord(data, platformsSize);
+        putWord(data, uint32_t(INDEX_HEADER_SIZE + roms.size() * INDEX_ROM_ENTRY_SIZE + programTable.size()));
+        putWord(data, 0);  // reserved
+        for(const auto& [digest, program] : roms) {
+            for(auto word : digest.words) {
+                data.push_back(word >> 24); data.push_back(word >> 16); data.push_back(word >> 8); data.push_back(word);
+            }
+            putWord(data, program);
+        }
+        data.insert(data.end(), programTable.begin(), programTable.end());
+        data.insert(data.end(), pool.begin(), pool.end());
+        std::ofstream ofs(indexFile, std::ios::binary | std::ios::trunc);
+        return ofs && ofs.write((const char*)data.data(), std::streamsize(data.size()));
+    }
+
+    bool isIndexed() const { return !indexData.empty(); }
+    size_t numRoms() const { return isIndexed() ? indexRoms : romLookupTable.size(); }
     const auto& platforms() const { return platformList; }
-    const auto& programs() const { return programList; }
+    // all programs, when loaded from an index this decodes every program that wasn't before
+    const std::vector<Program>& programs() const
+    {
+        if(isIndexed() && programList.size() != indexPrograms) {
+            programList.clear();
+            for(uint32_t i = 0; i < indexPrograms; ++i)
+                programList.push_back(indexedProgram(i));
+        }
+        return programList;
+    }
     const Platform* findPlatform(const std::string& name) const
     {
         auto iter = std::find_if(platformList.begin(), platformList.end(), [&](const auto& p) { return p.id == name; });
@@ -269,10 +373,34 @@ public:
 
     std::vector<RomInfo> findProgram(const std::string& sha1sum) const
     {
-        auto iter = romLookupTable.find(sha1sum);
         std::vector<RomInfo> info;
-        if(iter != romLookupTable.end()) {
-            const auto& program = *iter->second;
+        const Program* found = nullptr;
+        if(isIndexed()) {
+            auto digest = Sha1Digest::fromHex(sha1sum);
+            uint8_t key[20];
+            for(size_t i = 0; i < 20; ++i)
+                key[i] = uint8_t(digest.words[i / 4] >> (24 - (i % 4) * 8));
+            size_t first = 0, count = indexRoms;
+            while(count) {
+                auto step = count / 2;
+                if(std::memcmp(indexData.data() + INDEX_HEADER_SIZE + (first + step) * INDEX_ROM_ENTRY_SIZE, key, 20) < 0) {
+                    first += step + 1;
+                    count -= step + 1;
+                }
+                else
+                    count = step;
+            }
+            const auto* entry = indexData.data() + INDEX_HEADER_SIZE + first * INDEX_ROM_ENTRY_SIZE;
+            if(first < indexRoms && std::memcmp(entry, key, 20) == 0)
+                found = &indexedProgram(getWord(entry + 20));
+        }
+        else {
+            auto iter = romLookupTable.find(sha1sum);
+            if(iter != romLookupTable.end())
+                found = iter->second;
+        }
+        if(found) {
+            const auto& program = *found;
             for(const auto& [sha,rom] : program.roms) {
                 if(sha1sum == sha) {
                     for(const auto& platform : rom.platforms) {
@@ -297,10 +425,40 @@ public:
 
     bool exportPrograms(const std::string& outputFilePath)
     {
-        return writePrograms(outputFilePath, programList);
+        return writePrograms(outputFilePath, programs());
     }
 
 private:
+    Database() = default;
+
+    static uint32_t getWord(const uint8_t* data)
+    {
+        return uint32_t(data[0]) | (uint32_t(data[1]) << 8) | (uint32_t(data[2]) << 16) | (uint32_t(data[3]) << 24);
+    }
+
+    static void putWord(std::vector<uint8_t>& data, uint32_t val)
+    {
+        data.push_back(val); data.push_back(val >> 8); data.push_back(val >> 16); data.push_back(val >> 24);
+    }
+
+    uint32_t indexWord(size_t offset) const { return getWord(indexData.data() + offset); }
+
+    // Decodes a program of the index on first access, later ones get the cached record
+    const Program& indexedProgram(uint32_t index) const
+    {
+        auto& program = programCache.at(index);
+        if(!program) {
+            program = std::make_unique<Program>();
+            auto offset = indexWord(indexProgramTable + index * INDEX_PROGRAM_ENTRY_SIZE);
+            auto size = indexWord(indexProgramTable + index * INDEX_PROGRAM_ENTRY_SIZE + 4);
+            if(indexPool + size_t(offset) + size <= indexData.size()) {
+                auto start = indexData.begin() + indexPool + offset;
+                from_json(json::from_msgpack(start, start + size), *program);
+            }
+        }
+        return *program;
+    }
+
     std::vector<Platform> readPlatforms(const std::string& filepath)
     {
         std::vector<Platform> result;
@@ -334,7 +492,7 @@ private:
         return true;
     }
 
-    void to_json_ordered(nlohmann::ordered_json& j, const Program::Rom& rom)
+    static void to_json_ordered(nlohmann::ordered_json& j, const Program::Rom& rom)
     {
         if(!rom.file.empty()) j["file"] = rom.file;
         if(!rom.embeddedTitle.empty()) j["embeddedTitle"] = rom.embeddedTitle;
@@ -356,7 +514,7 @@ private:
         if(rom.colors.silence) j["colors"]["silence"] = json(*rom.colors.silence);
     }
 
-    void to_json_ordered(nlohmann::ordered_json& j, const Program& prg)
+    static void to_json_ordered(nlohmann::ordered_json& j, const Program& prg)
     {
         j["title"] = prg.title;
         if(prg.origin.type != OriginType::UNKNOWN) j["origin"] = json(prg.origin);
@@ -422,8 +580,14 @@ private:
     std::string platformsFile;
     std::string programsFile;
     std::vector<Platform> platformList;
-    std::vector<Program> programList;
+    mutable std::vector<Program> programList;  // filled on demand when loaded from an index
     std::unordered_map<std::string,Program*> romLookupTable;
+    std::vector<uint8_t> indexData;
+    uint32_t indexRoms{0};
+    uint32_t indexPrograms{0};
+    size_t indexProgramTable{0};
+    size_t indexPool{0};
+    mutable std::vector<std::unique_ptr<Program>> programCache;
 };
 
 }
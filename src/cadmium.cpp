@@ -42,18 +42,23 @@ extern "C" {
 #include <chiplet/chip8decompiler.hpp>
 #include <emulation/chip8cores.hpp>
 #include <emulation/chip8dream.hpp>
+#include <emulation/crtfilter.hpp>
 #include <emulation/time.hpp>
 #include <emulation/timecontrol.hpp>
+#include <emulation/wavfile.hpp>
 #include <chiplet/utility.hpp>
 #include <ghc/cli.hpp>
 #include <chip8emuhostex.hpp>
 #include <systemtools.hpp>
 #include <resourcemanager.hpp>
 #include <circularbuffer.hpp>
+#include <triplebuffer.hpp>
+#include <frametelemetry.hpp>
 #include <debugger.hpp>
 #include <logview.hpp>
 #include <nlohmann/json.hpp>
 
+#include <algorithm>
 #include <atomic>
 #include <chrono>
 #include <cstdint>
@@ -61,11 +66,13 @@ extern "C" {
 #include <cstdlib>
 #include <cstring>
 #include <iomanip>
+#include <iterator>
 #include <memory>
 #include <regex>
 #include <thread>
 #include <mutex>
 #include <new>
+#include <optional>
 
 #ifdef PLATFORM_WEB
 #include <emscripten/emscripten.h>
@@ -507,9 +514,15 @@ public:
     enum FileBrowserMode { eLOAD, eSAVE, eWEB_SAVE };
     static constexpr int MIN_SCREEN_WIDTH = 512;
     static constexpr int MIN_SCREEN_HEIGHT = 192*2+36;
+    static constexpr int CRT_SCALE = 4;
+    static constexpr int AUDIO_SAMPLE_RATE = 44100;
+    static constexpr int AUDIO_STREAM_FRAMES = 512;
+    static constexpr int AUDIO_TARGET_FILL = 1024;          // samples queued in the ring, about 23ms
+    static constexpr double AUDIO_MAX_RATE_ADJUST = 0.005;  // emulation speed may deviate by ±0.5%
+    static constexpr int TURBO_FRAME_BUDGET_US = 12000;     // emulation time per 60Hz host frame in turbo mode
+    static constexpr int TURBO_THREAD_SLICE_US = 4000;      // turbo slice of the emulation thread between UI lock windows
     Cadmium(const emu::Chip8EmulatorOptions* chip8options = nullptr)
-        : _audioBuffer(44100)
-        , _screenWidth(MIN_SCREEN_WIDTH)
+        : _screenWidth(MIN_SCREEN_WIDTH)
         , _screenHeight(MIN_SCREEN_HEIGHT)
     {
         SetTraceLogCallback(LogHandler);
@@ -541,8 +554,8 @@ public:
 
         _instance = this;
         InitAudioDevice();
-        SetAudioStreamBufferSizeDefault(1470);
-        _audioStream = LoadAudioStream(44100, 16, 1);
+        SetAudioStreamBufferSizeDefault(AUDIO_STREAM_FRAMES);
+        _audioStream = LoadAudioStream(AUDIO_SAMPLE_RATE, 16, 1);
         SetAudioStreamCallback(_audioStream, Cadmium::audioInputCallback);
         PlayAudioStream(_audioStream);
         SetTargetFPS(60);
@@ -589,7 +602,8 @@ public:
         _debugger.updateCore(_chipEmu.get());
         _screen = GenImageColor(emu::Chip8EmulatorBase::MAX_SCREEN_WIDTH, emu::Chip8EmulatorBase::MAX_SCREEN_HEIGHT, BLACK);
         _screenTexture = LoadTextureFromImage(_screen);
-        _crt = GenImageColor(256,512,BLACK);
+        _crt = GenImageColor(emu::Chip8EmulatorBase::MAX_SCREEN_WIDTH * CRT_SCALE, emu::Chip8EmulatorBase::MAX_SCREEN_HEIGHT * CRT_SCALE, BLACK);
+        _crtFilter.setSettings({CRT_SCALE});
         _crtTexture = LoadTextureFromImage(_crt);
         _screenShot = GenImageColor(emu::Chip8EmulatorBase::MAX_SCREEN_WIDTH, emu::Chip8EmulatorBase::MAX_SCREEN_HEIGHT, BLACK);
         _screenShotTexture = LoadTextureFromImage(_screen);
@@ -668,6 +682,7 @@ public:
 
     ~Cadmium() override
     {
+        stopEmulationThread();
         gui::UnloadGui();
         UnloadFont(_font);
         UnloadImage(_fontImage);
@@ -736,47 +751,68 @@ public:
         }
     }
 
+    // Runs on the audio thread, the emulation is only reached through the sample ring,
+    // so this never blocks and never touches emulator state
     void renderAudio(int16_t *samples, unsigned int frames)
     {
-        std::scoped_lock lock(_audioMutex);
         _audioCallbackAvgFrames = _audioCallbackAvgFrames ? (_audioCallbackAvgFrames + frames)/2 : frames;
-        if(_chipEmu) {
-            if(_chipEmu->getExecMode() == emu::GenericCpu::eRUNNING) {
-                auto len = _audioBuffer.read(samples, frames);
-                if(!len) {
-                    while(frames--) {
-                        *samples++ = 0;
-                    }
-                    return;
-                }
-                frames -= len;
-                samples += len;
-                if(frames) {
-                    _chipEmu->renderAudio(samples, frames, 44100);
-                    frames = 0;
-                }
-            }
-        }
-        while(frames--) {
-            *samples++ = 0;
-        }
+        size_t len = _audioRunning ? _audioBuffer.read(samples, frames) : 0;
+        std::fill(samples + len, samples + frames, 0);
     }
 
     void pushAudio(int frames)
     {
         static int16_t sampleBuffer[44100];
+        FrameTelemetry::Scope telemetryScope(_telemetry, FrameTelemetry::eAUDIO);
         if(_chipEmu->getExecMode() == emu::IChip8Emulator::eRUNNING) {
-            //if(_audioBuffer.dataAvailable() < _audioCallbackAvgFrames) ++frames;
-            if(frames > _audioBuffer.spaceAvailable()) frames = _audioBuffer.spaceAvailable();
-            _chipEmu->renderAudio(sampleBuffer, frames, 44100);
+            // the callback doesn't render on its own anymore, so keep one callback block queued
+            int available = int(_audioBuffer.dataAvailable());
+            int callbackFrames = _audioCallbackAvgFrames;
+            if(available < callbackFrames)
+                frames += callbackFrames - available;
+            frames = std::min({frames, int(_audioBuffer.spaceAvailable()), int(std::size(sampleBuffer))});
+            _chipEmu->renderAudio(sampleBuffer, frames, AUDIO_SAMPLE_RATE);
             _audioBuffer.write(sampleBuffer, frames);
+            updateAudioRate();
         }
     }
 
+    // Dynamic rate control: the audio device clock and the frame pacing drift apart, so the
+    // emulation speed is steered by up to ±0.5% to keep the ring at its target fill level
+    void updateAudioRate()
+    {
+        _audioFillAverage += (double(_audioBuffer.dataAvailable()) - _audioFillAverage) * 0.05;
+        auto error = std::clamp((AUDIO_TARGET_FILL - _audioFillAverage) / AUDIO_TARGET_FILL, -1.0, 1.0);
+        _audioRateFactor = 1.0 + AUDIO_MAX_RATE_ADJUST * error;
+    }
+
+    void resetAudio()
+    {
+        _audioBuffer.reset();
+        _audioFillAverage = AUDIO_TARGET_FILL;
+        _audioRateFactor = 1.0;
+    }
+
+    uint64_t audioUnderruns() const { return _audioBuffer.underruns(); }
+
+    void setTelemetryFile(const std::string& filename) { _telemetryFile = filename; }
+
+    // Writes the frame timing history to the --telemetry file or to frametimes.csv in the data directory
+    bool exportTelemetry()
+    {
+        auto filename = _telemetryFile.empty() ? (fs::path(dataPath()) / "frametimes.csv").string() : _telemetryFile;
+        if(!_telemetry.exportToFile(filename)) {
+            TraceLog(LOG_ERROR, "Couldn't write frame timing to '%s'", filename.c_str());
+            return false;
+        }
+        TraceLog(LOG_INFO, "Frame timing of %d frames written to '%s'", int(_telemetry.size()), filename.c_str());
+        return true;
+    }
+
     void vblank() override
     {
-        if(_chipEmu)
-            pushAudio(44100 / _options.frameRate);
+        if(_chipEmu && !_turboRunning)
+            pushAudio(AUDIO_SAMPLE_RATE / _options.frameRate);
     }
 
     int getKeyPressed() override
@@ -787,6 +823,8 @@ public:
         auto now = GetTime();
         for(int i = 0; i < 16; ++i)
             _keyScanTime[i] = now;
+        if(isEmulationThread())
+            return getForwardedKeyPressed();
         if(waitKeyUp && instruction == _chipEmu->getPC()) {
             if(IsKeyUp(waitKeyUp)) {
                 waitKeyUp = 0;
@@ -813,6 +851,8 @@ public:
     bool isKeyDown(uint8_t key) override
     {
         _keyScanTime[key & 0xF] = GetTime();
+        if(isEmulationThread())
+            return _forwardedKeysDown & (1 << (key & 0xF));
         return !gui::IsSysKeyDown() && IsKeyDown(_keyMapping[key & 0xF]);
     }
 
@@ -974,24 +1014,250 @@ public:
 
     void updateScreen() override
     {
+        if(_turboRunning) {
+            // only the last frame of a turbo run gets presented
+            _turboScreenPending = true;
+            return;
+        }
+        if(isEmulationThread()) {
+            // the UI thread uploads the newest of the published frames on its next update
+            auto& frame = _videoFrames.back();
+            frame.pixel.resize(emu::Chip8EmulatorBase::MAX_SCREEN_WIDTH * emu::Chip8EmulatorBase::MAX_SCREEN_HEIGHT);
+            {
+                FrameTelemetry::Scope telemetryScope(_telemetry, FrameTelemetry::eSCREEN_CONVERSION);
+                convertScreen(frame.pixel.data(), emu::Chip8EmulatorBase::MAX_SCREEN_WIDTH);
+            }
+            frame.width = _chipEmu->getCurrentScreenWidth();
+            frame.height = _chipEmu->isGenericEmulation() ? _chipEmu->getCurrentScreenHeight() : 128;
+            _videoFrames.publish();
+            return;
+        }
         auto* pixel = (uint32_t*)_screen.data;
         if(pixel) {
-            const auto* screen = _chipEmu->getScreen();
-            if (screen) {
-                if (!_renderCrt) {
-                    screen->convert(pixel, _screen.width, 255, nullptr);
-                    UpdateTexture(_screenTexture, _screen.data);
+            // frames published before this update are outdated
+            _videoFrames.consume();
+            {
+                FrameTelemetry::Scope telemetryScope(_telemetry, FrameTelemetry::eSCREEN_CONVERSION);
+                convertScreen(pixel, _screen.width);
+            }
+            presentScreen(_chipEmu->getCurrentScreenWidth(), _chipEmu->isGenericEmulation() ? _chipEmu->getCurrentScreenHeight() : 128);
+        }
+    }
+
+    void convertScreen(uint32_t* pixel, int stride)
+    {
+        const auto* screen = _chipEmu->getScreen();
+        if (screen) {
+            screen->convert(pixel, stride, 255, nullptr);
+        }
+        else {
+            // TraceLog(LOG_INFO, "Updating MC8 screen!");
+            const auto* screen = _chipEmu->getScreenRGBA();
+            screen->convert(pixel, stride, _chipEmu->getScreenAlpha(), _chipEmu->getWorkRGBA());
+        }
+    }
+
+    // Texture upload, including the CRT post-processing if that is active
+    void presentScreen(int width, int height)
+    {
+        FrameTelemetry::Scope telemetryScope(_telemetry, FrameTelemetry::eTEXTURE_UPLOAD);
+        if (!_renderCrt) {
+            UpdateTexture(_screenTexture, _screen.data);
+        }
+        else {
+            _crtFilter.process((uint32_t*)_screen.data, width, height, _screen.width, (uint32_t*)_crt.data, _crt.width);
+            UpdateTexture(_crtTexture, _crt.data);
+        }
+    }
+
+    void presentPublishedFrame()
+    {
+        if(_videoFrames.consume()) {
+            const auto& frame = _videoFrames.front();
+            std::memcpy(_screen.data, frame.pixel.data(), frame.pixel.size() * sizeof(uint32_t));
+            presentScreen(frame.width, frame.height);
+        }
+    }
+
+    //-----------------------------------------------------------------------------------
+    // Optional emulation thread: it owns the emulator while running and ticks it on its
+    // own schedule, the UI thread only touches the emulator while holding the lock from
+    // pauseEmulation(), that waits for the current emulation frame to end
+    //-----------------------------------------------------------------------------------
+    void startEmulationThread()
+    {
+        if(!_emulationThread.joinable()) {
+            _stopEmulation = false;
+            _emulationThread = std::thread(&Cadmium::emulationLoop, this);
+        }
+    }
+
+    void stopEmulationThread()
+    {
+        if(_emulationThread.joinable()) {
+            _stopEmulation = true;
+            _emulationThread.join();
+            _emulationThreadId = std::thread::id();
+        }
+    }
+
+    bool isEmulationThread() const
+    {
+        return _emulationThreadId.load() == std::this_thread::get_id();
+    }
+
+    std::unique_lock<std::mutex> pauseEmulation()
+    {
+        if(!_emulationThread.joinable())
+            return {};
+        // std::mutex isn't fair, so announce the request, the emulation thread backs off
+        // before relocking while a request is pending
+        ++_lockRequests;
+        std::unique_lock<std::mutex> lock(_emulationMutex);
+        --_lockRequests;
+        return lock;
+    }
+
+    // Copies what the toolbar, status bar and video view show, so only the views that
+    // inspect or change the emulator need to hold the lock while drawing
+    void snapshotEmulationState()
+    {
+        auto lock = pauseEmulation();
+        _emuState.cycles = _chipEmu->getCycles();
+        _emuState.machineCycles = _chipEmu->getMachineCycles();
+        _emuState.frames = _chipEmu->frames();
+        _emuState.execMode = _chipEmu->getExecMode();
+        _emuState.cpuState = _chipEmu->cpuState();
+        if(_emuState.cpuState == CpuState::eERROR)
+            _emuState.errorMessage = _chipEmu->errorMessage();
+        _emuState.screenWidth = _chipEmu->getCurrentScreenWidth();
+        _emuState.screenHeight = _chipEmu->getCurrentScreenHeight();
+        _emuState.genericEmulation = _chipEmu->isGenericEmulation();
+        _emuState.frameRate = _chipEmu->frameRate();
+        _emuState.fps = _fps.getFps();
+    }
+
+    static void sleepUntil(std::chrono::steady_clock::time_point time)
+    {
+        // sleep granularity can be as bad as 15ms, so the last part is spent yielding
+        auto coarse = time - std::chrono::milliseconds(2);
+        if(std::chrono::steady_clock::now() < coarse)
+            std::this_thread::sleep_until(coarse);
+        while(std::chrono::steady_clock::now() < time)
+            std::this_thread::yield();
+    }
+
+    //-----------------------------------------------------------------------------------
+    // Turbo mode: runs as many emulated frames as fit into the time budget, every frame
+    // still does its timer handling, so timers and frame counters stay correct, but only
+    // the last screen is presented and audio is only generated to keep the ring at its
+    // target fill, so it is decimated instead of sped up
+    //-----------------------------------------------------------------------------------
+    int runTurbo(std::chrono::microseconds budget)
+    {
+        auto end = std::chrono::steady_clock::now() + budget;
+        int frames = 0;
+        _turboRunning = true;
+        _turboScreenPending = false;
+        do {
+            _chipEmu->tick(getInstrPerFrame());
+            ++frames;
+        }
+        while(_chipEmu->getExecMode() == ExecMode::eRUNNING && !_chipEmu->isBreakpointTriggered() && std::chrono::steady_clock::now() < end);
+        _turboRunning = false;
+        if(_chipEmu->needsScreenUpdate() || _turboScreenPending)
+            updateScreen();
+        auto available = int(_audioBuffer.dataAvailable());
+        if(available < AUDIO_TARGET_FILL)
+            pushAudio(AUDIO_TARGET_FILL - available);
+        return frames;
+    }
+
+    void emulationLoop()
+    {
+        _emulationThreadId = std::this_thread::get_id();
+        auto nextFrame = std::chrono::steady_clock::now();
+        while(!_stopEmulation) {
+            std::chrono::nanoseconds frameDuration;
+            bool turbo = false;
+            {
+                std::scoped_lock lock(_emulationMutex);
+                frameDuration = std::chrono::nanoseconds(int64_t(1000000000.0 / (_chipEmu->frameRate() * _audioRateFactor)));
+                if(_turbo && _chipEmu->getExecMode() == ExecMode::eRUNNING) {
+                    FrameTelemetry::Scope telemetryScope(_telemetry, FrameTelemetry::eEMULATION);
+                    _telemetry.addEmulationFrames(runTurbo(std::chrono::microseconds(TURBO_THREAD_SLICE_US)));
+                    if(_chipEmu->isBreakpointTriggered())
+                        _breakpointTriggered = true;
+                    turbo = true;
                 }
-                else {
+                else if(_chipEmu->getExecMode() != ExecMode::ePAUSED) {
+                    FrameTelemetry::Scope telemetryScope(_telemetry, FrameTelemetry::eEMULATION);
+                    for(int i = 0; i < getFrameBoost(); ++i) {
+                        _chipEmu->tick(getInstrPerFrame());
+                        if(_chipEmu->isBreakpointTriggered())
+                            _breakpointTriggered = true;
+                    }
+                    _telemetry.addEmulationFrames(getFrameBoost());
+                    _fps.add(GetTime()*1000);
+                    if(_chipEmu->needsScreenUpdate())
+                        updateScreen();
                 }
             }
-            else {
-                // TraceLog(LOG_INFO, "Updating MC8 screen!");
-                const auto* screen = _chipEmu->getScreenRGBA();
-                screen->convert(pixel, _screen.width, _chipEmu->getScreenAlpha(), _chipEmu->getWorkRGBA());
-                UpdateTexture(_screenTexture, _screen.data);
+            if(turbo) {
+                // no pacing, but hand the lock over if the UI thread is waiting for it
+                nextFrame = std::chrono::steady_clock::now();
+                while(_lockRequests.load() && !_stopEmulation)
+                    std::this_thread::yield();
+                continue;
+            }
+            nextFrame += frameDuration;
+            auto now = std::chrono::steady_clock::now();
+            if(now - nextFrame > std::chrono::milliseconds(100)) {
+                // don't try to catch up after a long stall
+                nextFrame = now;
+            }
+            sleepUntil(nextFrame);
+        }
+    }
+
+    // Keys are sampled on the UI thread, as raylib input functions are not thread safe
+    void forwardKeys()
+    {
+        uint16_t down = 0, pressed = 0;
+        if(!gui::IsSysKeyDown()) {
+            for(int i = 0; i < 16; ++i) {
+                if(IsKeyDown(_keyMapping[i]))
+                    down |= 1 << i;
+                if(IsKeyPressed(_keyMapping[i]))
+                    pressed |= 1 << i;
+            }
+        }
+        _forwardedKeysDown = down;
+        _forwardedKeysPressed |= pressed;
+    }
+
+    int getForwardedKeyPressed()
+    {
+        if(_forwardedWaitKey && _forwardedWaitInstruction == _chipEmu->getPC()) {
+            if(!(_forwardedKeysDown & (1 << (_forwardedWaitKey - 1)))) {
+                auto keyId = _forwardedWaitKey;
+                _forwardedWaitKey = 0;
+                return keyId;
+            }
+            return -1;
+        }
+        _forwardedWaitKey = 0;
+        uint16_t pressed = _forwardedKeysPressed.exchange(0);
+        if(pressed) {
+            for(int i = 0; i < 16; ++i) {
+                if(pressed & (1 << i)) {
+                    _forwardedWaitInstruction = _chipEmu->getPC();
+                    _forwardedWaitKey = i + 1;
+                    break;
+                }
             }
         }
+        return 0;
     }
 
     static void updateAndDrawFrame(void* self)
@@ -1003,6 +1269,7 @@ public:
     {
         static auto lastFrameTime = std::chrono::steady_clock::now() - std::chrono::milliseconds(16);
         auto now = std::chrono::steady_clock::now();
+        _telemetry.beginFrame();
         double deltaTC = std::chrono::duration<double>(now - lastFrameTime).count();
         lastFrameTime = now;
         float deltaT = GetFrameTime();
@@ -1045,38 +1312,68 @@ public:
 
         updateResolution();
 
-        _librarian.update(_options); // allows librarian to complete background tasks
+        {
+            FrameTelemetry::Scope telemetryScope(_telemetry, FrameTelemetry::eBACKGROUND);
+            _librarian.update(_options); // allows librarian to complete background tasks
+        }
 
+        // the emulation thread is only held off while emulator state is changed or inspected,
+        // without that thread the locks are empty and the emulator is ticked right here
         if (IsFileDropped()) {
             auto files = LoadDroppedFiles();
             if (files.count > 0) {
                 //TraceLog(LOG_INFO, "About to load one of %d dropped files.", (int)files.count);
+                auto lock = pauseEmulation();
                 loadRom(files.paths[0], LoadOptions::None);
             }
             UnloadDroppedFiles(files);
         }
 
         if(_mainView == eEDITOR) {
+            // compiling doesn't touch the emulator, only applying a changed result does
+            FrameTelemetry::Scope telemetryScope(_telemetry, FrameTelemetry::eBACKGROUND);
             _editor.update();
-            if(!_editor.compiler().isError() && _editor.compiler().sha1().to_hex() != _romSha1Hex) {
-                _romImage.assign(_editor.compiler().code(), _editor.compiler().code() + _editor.compiler().codeSize());
-                _romSha1Hex = _editor.compiler().sha1().to_hex();
-                _debugger.updateOctoBreakpoints(_editor.compiler());
-                reloadRom();
-            }
+        }
+
+        auto emulationLock = pauseEmulation();
+        if(_mainView == eEDITOR && !_editor.compiler().isError() && _editor.compiler().sha1().to_hex() != _romSha1Hex) {
+            _romImage.assign(_editor.compiler().code(), _editor.compiler().code() + _editor.compiler().codeSize());
+            _romSha1Hex = _editor.compiler().sha1().to_hex();
+            _debugger.updateOctoBreakpoints(_editor.compiler());
+            reloadRom();
         }
 
         for(uint8_t key = 0; key < 16; ++key) {
             _keyMatrix[key] = IsKeyDown(_keyMapping[key & 0xF]);
         }
 
-        if(_chipEmu->getExecMode() != ExecMode::ePAUSED) {
-            _partialFrameTime += GetFrameTime()*1000 * _chipEmu->frameRate();
+        _audioRunning = _chipEmu->getExecMode() == ExecMode::eRUNNING;
+        if(_emulationThread.joinable()) {
+            forwardKeys();
+            if(_breakpointTriggered.exchange(false))
+                _mainView = eDEBUGGER;
+            emulationLock.unlock();
+            presentPublishedFrame();
+            if(_showKeyMap)
+                updateKeyboardOverlay();
+        }
+        else if(_turbo && _chipEmu->getExecMode() == ExecMode::eRUNNING) {
+            FrameTelemetry::Scope telemetryScope(_telemetry, FrameTelemetry::eEMULATION);
+            _telemetry.addEmulationFrames(runTurbo(std::chrono::microseconds(TURBO_FRAME_BUDGET_US)));
+            if(_chipEmu->isBreakpointTriggered())
+                _mainView = eDEBUGGER;
+            _partialFrameTime = 0;
+            if(_showKeyMap)
+                updateKeyboardOverlay();
+        }
+        else if(_chipEmu->getExecMode() != ExecMode::ePAUSED) {
+            _partialFrameTime += GetFrameTime()*1000 * _chipEmu->frameRate() * _audioRateFactor;
             if(_partialFrameTime > 10000) {
                 _fps.reset();
                 _partialFrameTime = 1000;
             }
             if(_partialFrameTime >= 1000) {
+                FrameTelemetry::Scope telemetryScope(_telemetry, FrameTelemetry::eEMULATION);
                 while (_partialFrameTime >= 1000) {
                     _partialFrameTime -= 1000;
                     for(int i = 0; i < getFrameBoost(); ++i) {
@@ -1084,6 +1381,7 @@ public:
                         if(_chipEmu->isBreakpointTriggered())
                             _mainView = eDEBUGGER;
                     }
+                    _telemetry.addEmulationFrames(getFrameBoost());
                     _fps.add(GetTime()*1000);
                 }
             }
@@ -1093,6 +1391,10 @@ public:
                 updateKeyboardOverlay();
         }
 
+        if(emulationLock)
+            emulationLock.unlock();
+
+        std::optional<FrameTelemetry::Scope> guiScope(std::in_place, _telemetry, FrameTelemetry::eGUI_DRAW);
         BeginTextureMode(_renderTexture);
         drawGui();
         EndTextureMode();
@@ -1131,6 +1433,9 @@ public:
             // DrawText(TextFormat("Res: %dx%d", GetMonitorWidth(GetCurrentMonitor()), GetMonitorHeight(GetCurrentMonitor())), 10, 30, 10, GREEN);
             // DrawFPS(10,45);
         }
+        // EndDrawing() swaps and waits for the next frame, so it is not part of the GUI time
+        guiScope.reset();
+        _telemetry.endFrame(_audioBuffer.dataAvailable(), audioUnderruns());
         EndDrawing();
     }
 
@@ -1139,18 +1444,19 @@ public:
     {
         const Color gridLineCol{40,40,40,255};
         bool crt = _renderCrt;
-        int scrWidth = crt ? 130 : _chipEmu->getCurrentScreenWidth();
-        int scrHeight = crt ? 385 : (_chipEmu->isGenericEmulation() ? _chipEmu->getCurrentScreenHeight() : 128);
+        const auto& state = _emuState;
+        int scrWidth = state.screenWidth;
+        int scrHeight = state.genericEmulation ? state.screenHeight : 128;
         auto videoScale = dest.width / scrWidth;
-        auto videoScaleY = _chipEmu->isGenericEmulation() ? videoScale : videoScale/4;
-        auto videoX = crt ? (dest.width - scrWidth * videoScale) / 2 + dest.x : (dest.width - _chipEmu->getCurrentScreenWidth() * videoScale) / 2 + dest.x;
-        auto videoY = crt ? (dest.height - scrHeight * videoScaleY) / 2 + dest.y : (dest.height - _chipEmu->getCurrentScreenHeight() * videoScaleY) / 2 + dest.y;
+        auto videoScaleY = state.genericEmulation ? videoScale : videoScale/4;
+        auto videoX = (dest.width - state.screenWidth * videoScale) / 2 + dest.x;
+        auto videoY = (dest.height - state.screenHeight * videoScaleY) / 2 + dest.y;
         if(_options.behaviorBase == emu::Chip8EmulatorOptions::eMEGACHIP)
             DrawRectangleRec(dest, {0,0,0,255});
         else
             DrawRectangleRec(dest, {0,12,24,255});
         if(crt)
-            DrawTexturePro(_crtTexture, {1, 1, (float)scrWidth-2, (float)scrHeight-2}, {videoX, videoY, scrWidth * videoScale, scrHeight * videoScaleY}, {0, 0}, 0, WHITE);
+            DrawTexturePro(_crtTexture, {0, 0, (float)scrWidth * CRT_SCALE, (float)scrHeight * CRT_SCALE}, {videoX, videoY, scrWidth * videoScale, scrHeight * videoScaleY}, {0, 0}, 0, WHITE);
         else
             DrawTexturePro(_screenTexture, {0, 0, (float)scrWidth, (float)scrHeight}, {videoX, videoY, scrWidth * videoScale, scrHeight * videoScaleY}, {0, 0}, 0, WHITE);
 //        DrawRectangleLines(videoX, videoY, scrWidth * videoScale, scrHeight * videoScaleY, RED);
@@ -1158,12 +1464,15 @@ public:
             for (short x = 0; x < scrWidth; ++x) {
                 DrawRectangle(videoX + x * gridScale, videoY, 1, scrHeight * videoScaleY, gridLineCol);
             }
-            if(_chipEmu->isGenericEmulation()) {
+            if(state.genericEmulation) {
                 for (short y = 0; y < scrHeight; ++y) {
                     DrawRectangle(videoX, videoY + y * gridScale, scrWidth * videoScale, 1, gridLineCol);
                 }
             }
         }
+        if(_showFrameTimes) {
+            drawFrameTimes({dest.x + 2, dest.y + 2, std::min(dest.width - 4, float(FrameTelemetry::HISTORY_SIZE / 2)), std::min(dest.height - 4, 64.0f)});
+        }
         if(_showKeyMap) {
             DrawTexturePro(_keyboardOverlay.texture, {0, 0, 40, -40}, {videoX + scrWidth * videoScale - 40.0f, videoY + scrHeight * videoScaleY - 40.0f, 40.0f, 40.0f}, {0, 0}, 0.0f, {255, 255, 255, 128});
         }
@@ -1181,6 +1490,36 @@ public:
 #endif
     }
 
+    // Stacked bars of the section times of the recent frames, one pixel column per
+    // frame, the full height is two frame budgets and the line marks one budget
+    void drawFrameTimes(Rectangle area)
+    {
+        static const Color sectionColors[FrameTelemetry::eNUM_SECTIONS] = {
+            {0x51, 0xbf, 0xd3, 0xff}, {0x8c, 0xd6, 0x5a, 0xff}, {0xf0, 0xc0, 0x40, 0xff}, {0xc0, 0x70, 0xe0, 0xff}, {0xf0, 0x80, 0x50, 0xff}, {0xa0, 0xa0, 0xa0, 0xff}
+        };
+        if(area.width < 2 || area.height < 2)
+            return;
+        DrawRectangleRec(area, {0, 0, 0, 160});
+        auto budget_us = 1000000.0f / float(_emuState.frameRate);
+        auto scale = area.height / (2 * budget_us);
+        auto bottom = area.y + area.height;
+        auto frames = std::min(_telemetry.size(), size_t(area.width));
+        for(size_t i = 0; i < frames; ++i) {
+            const auto& frame = _telemetry[_telemetry.size() - frames + i];
+            auto x = area.x + area.width - frames + i;
+            DrawRectangleRec({x, bottom - std::min(area.height, frame.duration_us * scale), 1, std::min(area.height, frame.duration_us * scale)}, {0x40, 0x40, 0x40, 0xff});
+            auto y = bottom;
+            for(int section = 0; section < FrameTelemetry::eNUM_SECTIONS && y > area.y; ++section) {
+                auto height = std::min(y - area.y, frame.section_us[section] * scale);
+                y -= height;
+                DrawRectangleRec({x, y, 1, height}, sectionColors[section]);
+            }
+            if(frame.audioUnderruns)
+                DrawRectangleRec({x, area.y, 1, 3}, RED);
+        }
+        DrawRectangleRec({area.x, bottom - budget_us * scale, area.width, 1}, {255, 255, 255, 96});
+    }
+
     static bool iconButton(int iconId, bool isPressed = false, Color color = {3, 127, 161}, Color foreground = {0x51, 0xbf, 0xd3, 0xff})
     {
         StyleManager::Scope guard;
@@ -1226,6 +1565,9 @@ public:
 
         static std::chrono::steady_clock::time_point volumeClick{};
 
+        snapshotEmulationState();
+        const auto& state = _emuState;
+
 #ifdef RESIZABLE_GUI
         auto screenScale = std::min(std::clamp(int(GetScreenWidth() / _screenWidth), 1, 8), std::clamp(int(GetScreenHeight() / _screenHeight), 1, 8));
         Vector2 mouseOffset = {-(GetScreenWidth() - _screenWidth*screenScale)/2.0f, -(GetScreenHeight() - _screenHeight*screenScale)/2.0f};
@@ -1242,12 +1584,12 @@ public:
 
             SetRowHeight(16);
             SetSpacing(0);
-            auto instructionsThisUpdate = _chipEmu->getCycles() - lastInstructionCount;
-            auto framesThisUpdate = _chipEmu->frames() - lastFrameCount;
-            if(_chipEmu->getExecMode() == emu::GenericCpu::eRUNNING) {
+            auto instructionsThisUpdate = state.cycles - lastInstructionCount;
+            auto framesThisUpdate = state.frames - lastFrameCount;
+            if(state.execMode == emu::GenericCpu::eRUNNING) {
                 _ipfAverage.add(instructionsThisUpdate);
-                _frameTimeAverage_us.add(GetFrameTime() * 1000000);
-                _frameDelta.add(framesThisUpdate);
+                _frameTimeAverage_us.add(GetFrameTime() * 1000000.0);
+                _frameDelta.add(double(framesThisUpdate));
             }
             auto ipfAvg = _ipfAverage.get();
             auto ftAvg_us = _frameTimeAverage_us.get();
@@ -1261,35 +1603,49 @@ public:
                            {0.15f, fmt::format("{}:{}", _editor.line(), _editor.column()).c_str()},
                            {0.1f, emu::Chip8EmulatorOptions::shortNameOfPreset(_options.behaviorBase)}});
             }
-            else if(_chipEmu->cpuState() == emu::IChip8Emulator::eERROR) {
-                StatusBar({{0.55f, _chipEmu->errorMessage().c_str()},
+            else if(state.cpuState == emu::IChip8Emulator::eERROR) {
+                StatusBar({{0.55f, state.errorMessage.c_str()},
                            {0.15f, formatUnit(ipsAvg, "IPS").c_str()},
-                           {0.15f, formatUnit(_fps.getFps(), "FPS").c_str()},
+                           {0.15f, formatUnit(state.fps, "FPS").c_str()},
+                           {0.1f, emu::Chip8EmulatorOptions::shortNameOfPreset(_options.behaviorBase)}});
+            }
+            else if(_turbo) {
+                // averaged in double, turbo runs rarely advance a whole number of frames per update
+                double speed = ftAvg_us > 0.0 ? fdAvg * 1000000.0 / ftAvg_us / state.frameRate : 0.0;
+                StatusBar({{0.5f, fmt::format("Instruction cycles: {} [{}]", state.cycles, state.frames).c_str()},
+                           {0.2f, formatUnit(ipsAvg, "IPS").c_str()},
+                           {0.15f, fmt::format("{:.1f}x", speed).c_str()},
                            {0.1f, emu::Chip8EmulatorOptions::shortNameOfPreset(_options.behaviorBase)}});
             }
             else if(getFrameBoost() > 1) {
-                StatusBar({{0.5f, fmt::format("Instruction cycles: {}", _chipEmu->getCycles()).c_str()},
+                StatusBar({{0.5f, fmt::format("Instruction cycles: {}", state.cycles).c_str()},
                            {0.2f, formatUnit(ipsAvg, "IPS").c_str()},
-                           {0.15f, formatUnit(_fps.getFps() * getFrameBoost(), "eFPS").c_str()},
+                           {0.15f, formatUnit(state.fps * getFrameBoost(), "eFPS").c_str()},
                            {0.1f, emu::Chip8EmulatorOptions::shortNameOfPreset(_options.behaviorBase)}});
             }
             else {
-                if(_chipEmu->getCycles() != _chipEmu->getMachineCycles()) {
-                    StatusBar({{0.55f, fmt::format("Instruction cycles: {}/{} [{}]", _chipEmu->getCycles(), _chipEmu->getMachineCycles(), _chipEmu->frames()).c_str()},
+                if(state.cycles != state.machineCycles) {
+                    StatusBar({{0.55f, fmt::format("Instruction cycles: {}/{} [{}]", state.cycles, state.machineCycles, state.frames).c_str()},
                                {0.15f, formatUnit(ipsAvg, "IPS").c_str()},
-                               {0.15f, formatUnit(_fps.getFps(), "FPS").c_str()},
+                               {0.15f, formatUnit(state.fps, "FPS").c_str()},
+                               {0.1f, emu::Chip8EmulatorOptions::shortNameOfPreset(_options.behaviorBase)}});
+                }
+                else if(audioUnderruns()) {
+                    StatusBar({{0.55f, fmt::format("Instruction cycles: {} [{}] ({} underruns)", state.cycles, state.frames, audioUnderruns()).c_str()},
+                               {0.15f, formatUnit(ipsAvg, "IPS").c_str()},
+                               {0.15f, formatUnit(state.fps, "FPS").c_str()},
                                {0.1f, emu::Chip8EmulatorOptions::shortNameOfPreset(_options.behaviorBase)}});
                 }
                 else {
-                    StatusBar({{0.55f, fmt::format("Instruction cycles: {} [{}]", _chipEmu->getCycles(), _chipEmu->frames()).c_str()},
+                    StatusBar({{0.55f, fmt::format("Instruction cycles: {} [{}]", state.cycles, state.frames).c_str()},
                                {0.15f, formatUnit(ipsAvg, "IPS").c_str()},
                                //{0.15f, formatUnit((double)getFrameBoost() * GetFPS(), "FPS").c_str()},
-                               {0.15f, formatUnit(_fps.getFps(), "FPS").c_str()},
+                               {0.15f, formatUnit(state.fps, "FPS").c_str()},
                                {0.1f, emu::Chip8EmulatorOptions::shortNameOfPreset(_options.behaviorBase)}});
                 }
             }
-            lastInstructionCount = _chipEmu->getCycles();
-            lastFrameCount = _chipEmu->frames();
+            lastInstructionCount = state.cycles;
+            lastFrameCount = state.frames;
             BeginColumns();
             {
                 SetRowHeight(20);
@@ -1300,11 +1656,11 @@ public:
                 static Vector2 aboutScroll{};
                 if(Button(GuiIconText(ICON_BURGER_MENU, "")))
                     menuOpen = true;
-                if(menuOpen || (IsSysKeyDown() && (IsKeyDown(KEY_N) || IsKeyDown(KEY_O) ||IsKeyDown(KEY_S) || IsKeyDown(KEY_K) || IsKeyDown(KEY_Q)))) {
+                if(menuOpen || (IsSysKeyDown() && (IsKeyDown(KEY_N) || IsKeyDown(KEY_O) ||IsKeyDown(KEY_S) || IsKeyDown(KEY_K) || IsKeyDown(KEY_T) || IsKeyDown(KEY_Q)))) {
 #ifndef PLATFORM_WEB
-                    Rectangle menuRect = {1, GetCurrentPos().y + 20, 110, 84};
+                    Rectangle menuRect = {1, GetCurrentPos().y + 20, 110, 108};
 #else
-                    Rectangle menuRect = {1, GetCurrentPos().y + 20, 110, 69};
+                    Rectangle menuRect = {1, GetCurrentPos().y + 20, 110, 81};
 #endif
                     BeginPopup(menuRect, &menuOpen);
                     SetRowHeight(12);
@@ -1318,6 +1674,7 @@ public:
                         _editor.setText(": main\n    jump main");
                         _romName = "unnamed.8o";
                         _editor.setFilename("");
+                        auto lock = pauseEmulation();
                         _chipEmu->removeAllBreakpoints();
                     }
                     if(LabelButton(" Open... [^O]") || (IsSysKeyDown() && IsKeyPressed(KEY_O))) {
@@ -1340,7 +1697,15 @@ public:
                         _showKeyMap = !_showKeyMap;
                         menuOpen = false;
                     }
+                    if(LabelButton(" Timing  [^T]") || (IsSysKeyDown() && IsKeyPressed(KEY_T))) {
+                        _showFrameTimes = !_showFrameTimes;
+                        menuOpen = false;
+                    }
 #ifndef PLATFORM_WEB
+                    if(LabelButton(" Export Timing")) {
+                        exportTelemetry();
+                        menuOpen = false;
+                    }
                     Space(3);
                     if(LabelButton(" Quit    [^Q]") || (IsSysKeyDown() && IsKeyPressed(KEY_Q)))
                         menuOpen = false, _shouldClose = true;
@@ -1398,21 +1763,23 @@ public:
                     _librarian.fetchDir(_currentDirectory);
 #endif
                 }
-                SetNextWidth(130);
+                SetNextWidth(110);
                 SetStyle(TEXTBOX, BORDER_WIDTH, 1);
                 TextBox(_romName, 4095);
 
                 bool chip8Control = _debugger.isControllingChip8();
                 Color controlBack = {3, 127, 161};
                 Color controlColor = Color{0x51, 0xbf, 0xd3, 0xff}; //chip8Control ? Color{0x51, 0xbf, 0xd3, 0xff} : Color{0x51, 0xff, 0xbf, 0xff};
-                if (iconButton(ICON_PLAYER_PAUSE, _chipEmu->getExecMode() == ExecMode::ePAUSED/*, controlBack, controlColor*/) || ((IsKeyDown(KEY_LEFT_SHIFT) || IsKeyDown(KEY_RIGHT_SHIFT)) && IsKeyPressed(KEY_F5))) {
+                if (iconButton(ICON_PLAYER_PAUSE, state.execMode == ExecMode::ePAUSED/*, controlBack, controlColor*/) || ((IsKeyDown(KEY_LEFT_SHIFT) || IsKeyDown(KEY_RIGHT_SHIFT)) && IsKeyPressed(KEY_F5))) {
+                    auto lock = pauseEmulation();
                     _chipEmu->setExecMode(ExecMode::ePAUSED);
                     if(_mainView == eEDITOR || _mainView == eSETTINGS) {
                         _mainView = eVIDEO;
                     }
                 }
                 SetTooltip("PAUSE [Shift+F5]");
-                if (iconButton(ICON_PLAYER_PLAY, _chipEmu->getExecMode() == ExecMode::eRUNNING/*, controlBack, controlColor*/) || (!IsKeyDown(KEY_LEFT_SHIFT) && !IsKeyDown(KEY_RIGHT_SHIFT) && IsKeyPressed(KEY_F5))) {
+                if (iconButton(ICON_PLAYER_PLAY, state.execMode == ExecMode::eRUNNING/*, controlBack, controlColor*/) || (!IsKeyDown(KEY_LEFT_SHIFT) && !IsKeyDown(KEY_RIGHT_SHIFT) && IsKeyPressed(KEY_F5))) {
+                    auto lock = pauseEmulation();
                     _debugger.setExecMode(ExecMode::eRUNNING);
                     if(_mainView == eEDITOR || _mainView == eSETTINGS) {
                         _mainView = _lastRunView;
@@ -1421,7 +1788,8 @@ public:
                 SetTooltip("RUN [F5]");
                 if(!_debugger.supportsStepOver())
                     GuiDisable();
-                if (iconButton(ICON_STEP_OVER, _chipEmu->getExecMode() == ExecMode::eSTEPOVER/*, controlBack, controlColor*/) || (!IsKeyDown(KEY_LEFT_SHIFT) && !IsKeyDown(KEY_RIGHT_SHIFT) && IsKeyPressed(KEY_F8))) {
+                if (iconButton(ICON_STEP_OVER, state.execMode == ExecMode::eSTEPOVER/*, controlBack, controlColor*/) || (!IsKeyDown(KEY_LEFT_SHIFT) && !IsKeyDown(KEY_RIGHT_SHIFT) && IsKeyPressed(KEY_F8))) {
+                    auto lock = pauseEmulation();
                     _debugger.setExecMode(ExecMode::eSTEPOVER);
                     if(_mainView == eEDITOR || _mainView == eSETTINGS) {
                         _mainView = eDEBUGGER;
@@ -1429,7 +1797,8 @@ public:
                 }
                 GuiEnable();
                 SetTooltip("STEP OVER [F8]");
-                if (iconButton(ICON_STEP_INTO, _chipEmu->getExecMode() == ExecMode::eSTEP/*, controlBack, controlColor*/) || (!IsKeyDown(KEY_LEFT_SHIFT) && !IsKeyDown(KEY_RIGHT_SHIFT) && IsKeyPressed(KEY_F7))) {
+                if (iconButton(ICON_STEP_INTO, state.execMode == ExecMode::eSTEP/*, controlBack, controlColor*/) || (!IsKeyDown(KEY_LEFT_SHIFT) && !IsKeyDown(KEY_RIGHT_SHIFT) && IsKeyPressed(KEY_F7))) {
+                    auto lock = pauseEmulation();
                     _debugger.setExecMode(ExecMode::eSTEP);
                     if(_mainView == eEDITOR || _mainView == eSETTINGS) {
                         _mainView = eDEBUGGER;
@@ -1438,7 +1807,8 @@ public:
                 SetTooltip("STEP INTO [F7]");
                 if(!_debugger.supportsStepOver())
                     GuiDisable();
-                if (iconButton(ICON_STEP_OUT, _chipEmu->getExecMode() == ExecMode::eSTEPOUT/*, controlBack, controlColor*/) || ((IsKeyDown(KEY_LEFT_SHIFT) || IsKeyDown(KEY_RIGHT_SHIFT)) && IsKeyPressed(KEY_F7))) {
+                if (iconButton(ICON_STEP_OUT, state.execMode == ExecMode::eSTEPOUT/*, controlBack, controlColor*/) || ((IsKeyDown(KEY_LEFT_SHIFT) || IsKeyDown(KEY_RIGHT_SHIFT)) && IsKeyPressed(KEY_F7))) {
+                    auto lock = pauseEmulation();
                     _debugger.setExecMode(ExecMode::eSTEPOUT);
                     if(_mainView == eEDITOR || _mainView == eSETTINGS) {
                         _mainView = eDEBUGGER;
@@ -1447,6 +1817,7 @@ public:
                 GuiEnable();
                 SetTooltip("STEP OUT [Shift+F7]");
                 if (iconButton(ICON_RESTART)) {
+                    auto lock = pauseEmulation();
                     reloadRom();
                     resetStats();
                     if(_mainView == eEDITOR || _mainView == eSETTINGS) {
@@ -1454,7 +1825,10 @@ public:
                     }
                 }
                 SetTooltip("RESTART");
-                int buttonsRight = 7;
+                if (iconButton(ICON_PLAYER_NEXT, _turbo) || (IsKeyPressed(KEY_TAB) && (_mainView == eVIDEO || _mainView == eDEBUGGER)))
+                    _turbo = !_turbo;
+                SetTooltip("TURBO [Tab]");
+                int buttonsRight = 8;
                 ++buttonsRight;
                 int avail = 202;
 #ifdef RESIZABLE_GUI
@@ -1470,6 +1844,12 @@ public:
                     _grid = !_grid;
                 GuiEnable();
                 SetTooltip("TOGGLE GRID");
+                if (iconButton(ICON_MONITOR, _renderCrt)) {
+                    auto lock = pauseEmulation();
+                    _renderCrt = !_renderCrt;
+                    updateScreen();
+                }
+                SetTooltip("TOGGLE CRT");
                 Space(10);
                 if (iconButton(ICON_ZOOM_ALL, _mainView == eVIDEO))
                     _mainView = eVIDEO;
@@ -1477,8 +1857,10 @@ public:
                 if (iconButton(ICON_CPU, _mainView == eDEBUGGER))
                     _mainView = eDEBUGGER;
                 SetTooltip("DEBUGGER");
-                if (iconButton(ICON_FILETYPE_TEXT, _mainView == eEDITOR))
+                if (iconButton(ICON_FILETYPE_TEXT, _mainView == eEDITOR)) {
+                    auto lock = pauseEmulation();
                     _mainView = eEDITOR, _chipEmu->setExecMode(ExecMode::ePAUSED);
+                }
                 SetTooltip("EDITOR");
                 if (iconButton(ICON_PRINTER, _mainView == eTRACELOG))
                     _mainView = eTRACELOG;
@@ -1504,12 +1886,13 @@ public:
             switch (_mainView) {
                 case eDEBUGGER: {
                     _lastView = _lastRunView = _mainView;
+                    auto lock = pauseEmulation();
                     _debugger.render(_font, [this](Rectangle video, int scale){ drawScreen(video, scale); });
                     break;
                 }
                 case eVIDEO: {
                     _lastView = _lastRunView = _mainView;
-                    gridScale = _screenWidth / _chipEmu->getCurrentScreenWidth();
+                    gridScale = _screenWidth / state.screenWidth;
                     video = {0, 20, (float)_screenWidth, (float)_screenHeight - 36};
                     drawScreen(video, gridScale);
                     break;
@@ -1530,6 +1913,7 @@ public:
                     break;
                 case eTRACELOG: {
                     _lastView = _mainView;
+                    auto lock = pauseEmulation();
                     SetSpacing(0);
                     Begin();
                     BeginPanel("Trace-Log", {1,1});
@@ -1543,6 +1927,7 @@ public:
                 }
                 case eSETTINGS: {
                     _lastView = _mainView;
+                    auto lock = pauseEmulation();
                     SetSpacing(0);
                     Begin();
                     BeginPanel("Settings");
@@ -1673,6 +2058,7 @@ public:
             }
             EndGui();
         }
+        auto lock = pauseEmulation();
         static auto lastExecMode = _chipEmu->getExecMode();
         if(_chipEmu->getExecMode() == ExecMode::eRUNNING || (_chipEmu->getExecMode() != ExecMode::ePAUSED && lastExecMode == ExecMode::ePAUSED)) {
             _instructionOffset = -1;
@@ -2051,6 +2437,8 @@ public:
         BeginTableView(area.height - 135, 4, &scroll);
         for(int i = 0; i < _librarian.numEntries(); ++i) {
             const auto& info = _librarian.getInfo(i);
+            if(!selectedInfo.analyzed && info.analyzed && info.filePath == selectedInfo.filePath)
+                selectedInfo = info; // analysis finished after it was selected
             auto rowCol = Color{0,0,0,0};
             if(info.analyzed) {
                 //if(info.type == Librarian::Info::eROM_FILE)
@@ -2096,6 +2484,7 @@ public:
                                 _currentFileName = "";
                         }
                         selectedInfo.analyzed = false;
+                        selectedInfo.filePath.clear();
                         selectedInfo.isKnown = false;
                         break;
                     }
@@ -2115,12 +2504,24 @@ public:
                 Label(date::format("%F", date::floor<std::chrono::seconds>(info.changeDate)).c_str());
         }
         EndTableView();
+        if(mode == eLOAD) {
+            // rows are 16 pixels high, the scroll offset is negative
+            auto firstVisible = size_t(std::max(0.0f, -scroll.y) / 16);
+            _librarian.prefetchThumbnails(firstVisible, size_t((area.height - 135) / 16) + 2, _defaultPalette);
+        }
 #endif
         Space(1);
         BeginColumns();
         SetNextWidth(25);
         Label("File:");
+        bool analyzing = _librarian.isAnalyzing();
+        if(analyzing)
+            SetNextWidth(area.width - 145);
         TextBox(_currentFileName, 4096);
+        if(analyzing) {
+            auto [analyzed, total] = _librarian.analysisProgress();
+            Label(fmt::format(" Analyzing {}/{}", analyzed, total).c_str());
+        }
         EndColumns();
         Space(2);
         switch(mode) {
@@ -2135,16 +2536,17 @@ public:
                 }
                 if(selectedInfo.analyzed) {
                     if(_screenShotSha1sum != selectedInfo.sha1sum) {
-                        _screenshotData = _librarian.genScreenshot(selectedInfo, _defaultPalette);
-                        _screenShotSha1sum = selectedInfo.sha1sum;
-                        if(_screenshotData.width && _screenshotData.pixel.size() == _screenshotData.width * _screenshotData.height) {
-                            auto* image = (uint32_t*)_screenShot.data;
-                            for(int y = 0; y < _screenshotData.height; ++y) {
-                                for(int x = 0; x < _screenshotData.width; ++x) {
-                                    image[y * _screenShot.width + x] = _screenshotData.pixel[y * _screenshotData.width + x];
+                        // thumbnails come from the cache or the background worker, until then none is shown
+                        if(auto thumbnail = _librarian.getThumbnail(selectedInfo, _defaultPalette)) {
+                            _screenshotData = std::move(*thumbnail);
+                            _screenShotSha1sum = selectedInfo.sha1sum;
+                            if(_screenshotData.width && _screenshotData.pixel.size() == _screenshotData.width * _screenshotData.height) {
+                                auto* image = (uint32_t*)_screenShot.data;
+                                for(int y = 0; y < _screenshotData.height; ++y) {
+                                    std::memcpy(image + y * _screenShot.width, _screenshotData.pixel.data() + y * _screenshotData.width, _screenshotData.width * sizeof(uint32_t));
                                 }
+                                UpdateTexture(_screenShotTexture, _screenShot.data);
                             }
-                            UpdateTexture(_screenShotTexture, _screenShot.data);
                         }
                     }
                     if(_screenShotSha1sum == selectedInfo.sha1sum && _screenshotData.width) {
@@ -2162,6 +2564,7 @@ public:
                     //    updateEmulatorOptions(emu::Chip8EmulatorOptions::optionsOfPreset(selectedInfo.variant));
                     //}
                     auto mainView = _mainView;
+                    auto lock = pauseEmulation();
                     loadRom(_librarian.fullPath(selectedInfo.filePath).c_str(), LoadOptions::None);
                     if(_mainView == mainView)
                         _mainView = _lastView;
@@ -2172,6 +2575,7 @@ public:
                     //    updateEmulatorOptions(emu::Chip8EmulatorOptions::optionsOfPreset(selectedInfo.variant));
                     //}
                     auto options = _options;
+                    auto lock = pauseEmulation();
                     loadRom(_librarian.fullPath(selectedInfo.filePath).c_str(), LoadOptions::None);
                     updateEmulatorOptions(options);
                     _mainView = _lastView;
@@ -2366,7 +2770,7 @@ public:
     void whenRomLoaded(const std::string& filename, bool autoRun, emu::OctoCompiler* compiler, const std::string& source) override
     {
         _logView.clear();
-        _audioBuffer.reset();
+        resetAudio();
         _frameBoost = 1;
         updateBehaviorSelects();
         _editor.setText(source);
@@ -2386,7 +2790,7 @@ public:
         if(!_romImage.empty()) {
             unsigned int size = 0;
             _chipEmu->reset();
-            _audioBuffer.reset();
+            resetAudio();
             updateScreen();
             _instructionOffset = -1;
             if(Librarian::isPrefixedTPDRom(_romImage.data(), _romImage.size()))
@@ -2403,7 +2807,6 @@ public:
     }
 
 private:
-    std::mutex _audioMutex;
     ResourceManager _resources;
     StyleManager _styleManager;
     Image _fontImage{};
@@ -2413,6 +2816,7 @@ private:
     Font _font{};
     Image _screen{};
     Image _crt{};
+    emu::CrtFilter _crtFilter;
     Image _screenShot{};
     Texture2D _titleTexture{};
     Texture2D _screenTexture{};
@@ -2421,10 +2825,50 @@ private:
     Librarian::Screenshot _screenshotData;
     std::string _screenShotSha1sum;
     RenderTexture _keyboardOverlay{};
-    CircularBuffer<int16_t,1> _audioBuffer;
-    int64_t _audioGaps{};
+    SpscRingBuffer<int16_t,65536> _audioBuffer;
+    std::atomic_bool _audioRunning{false};
+    double _audioFillAverage{AUDIO_TARGET_FILL};
+    std::atomic<double> _audioRateFactor{1.0};
+    struct VideoFrame
+    {
+        std::vector<uint32_t> pixel;
+        int width{0};
+        int height{0};
+    };
+    TripleBuffer<VideoFrame> _videoFrames;
+    struct EmulationState
+    {
+        int64_t cycles{0};
+        int64_t machineCycles{0};
+        int64_t frames{0};
+        ExecMode execMode{ExecMode::ePAUSED};
+        CpuState cpuState{CpuState::eNORMAL};
+        std::string errorMessage;
+        int screenWidth{64};
+        int screenHeight{32};
+        bool genericEmulation{true};
+        int frameRate{60};
+        float fps{0};
+    };
+    EmulationState _emuState;         // only touched by the UI thread, see snapshotEmulationState()
+    std::thread _emulationThread;
+    std::atomic<std::thread::id> _emulationThreadId{};
+    std::mutex _emulationMutex;
+    std::atomic_int _lockRequests{0};
+    std::atomic_bool _stopEmulation{false};
+    std::atomic_bool _breakpointTriggered{false};
+    std::atomic_uint16_t _forwardedKeysDown{0};
+    std::atomic_uint16_t _forwardedKeysPressed{0};
+    int _forwardedWaitKey{0};
+    uint32_t _forwardedWaitInstruction{0};
     bool _shouldClose{false};
     bool _showKeyMap{false};
+    bool _showFrameTimes{false};
+    std::atomic_bool _turbo{false};
+    bool _turboRunning{false};        // only touched by the thread running the emulation
+    bool _turboScreenPending{false};
+    FrameTelemetry _telemetry;
+    std::string _telemetryFile;
     int _screenWidth{};
     int _screenHeight{};
     RenderTexture _renderTexture{};
@@ -2432,8 +2876,8 @@ private:
     float _volumeSlider{0.5f};
     float _volume{0.5f};
     SMA<60,uint64_t> _ipfAverage;
-    SMA<120,uint32_t> _frameTimeAverage_us;
-    SMA<120,int> _frameDelta;
+    SMA<120,double,double> _frameTimeAverage_us;
+    SMA<120,double,double> _frameDelta;
     emu::FpsMeasure _fps;
     int _partialFrameTime{0};
 #ifndef RESIZABLE_GUI
@@ -2461,7 +2905,7 @@ private:
     //std::string _romSha1Hex;
     //bool _romIsWellKnown{false};
     //emu::Chip8EmulatorOptions _romWellKnownOptions;
-    std::array<double,16> _keyScanTime{};
+    std::array<std::atomic<double>,16> _keyScanTime{};  // written by the emulating thread, read for the key map overlay
     std::array<bool,16> _keyMatrix;
     volatile bool _grid{false};
     MainView _mainView{eDEBUGGER};
@@ -2791,6 +3235,11 @@ int main(int argc, char* argv[])
     bool startRom = false;
     bool screenDump = false;
     bool drawDump = false;
+    bool emulationThread = false;
+    std::string audioDump;
+    int64_t audioFrames = 600;
+    int64_t sampleRate = 44100;
+    std::string telemetryFile;
     std::string dumpInterpreter;
     emu::Chip8EmulatorOptions options;
     int64_t execSpeed = -1;
@@ -2805,6 +3254,11 @@ int main(int argc, char* argv[])
     cli.option({"-c", "--compare"}, compareRun, "Run and compare with reference engine, trace until diff");
     cli.option({"-r", "--run"}, startRom, "if a ROM is given (positional) start it");
     cli.option({"-b", "--benchmark"}, benchmark, "Run given number of cycles as benchmark");
+    cli.option({"--emulation-thread"}, emulationThread, "Run the emulation in its own thread, decoupled from the GUI frame rate");
+    cli.option({"--audio-dump"}, audioDump, "Run headless and write the audio output to the given WAV file");
+    cli.option({"--audio-frames"}, audioFrames, "Number of frames to run for --audio-dump, default: 600");
+    cli.option({"--sample-rate"}, sampleRate, "Sample rate used for --audio-dump, default: 44100");
+    cli.option({"--telemetry"}, telemetryFile, "Write the per frame timing of the last frames to the given file on exit, JSON if it ends in `.json`, CSV otherwise");
     cli.option({"-p", "--preset"}, presetName, "Select CHIP-8 preset to use: chip-8, chip-10, chip-48, schip1.0, schip1.1, megachip8, xo-chip of vip-chip-8", [&](){
         if(!presetName.empty()) {
             try {
@@ -2895,10 +3349,14 @@ int main(int argc, char* argv[])
         std::cerr << "ERROR: random generator must be 'rand-lgc' or 'counting' and trace must be used." << std::endl;
         exit(1);
     }
+    if(!audioDump.empty() && (audioFrames <= 0 || sampleRate < 8000 || sampleRate > 192000)) {
+        std::cerr << "ERROR: audio dump needs a positive frame count and a sample rate between 8000 and 192000." << std::endl;
+        exit(1);
+    }
     if(execSpeed >= 0) {
         options.instructionsPerFrame = execSpeed;
     }
-    if(traceLines < 0 && !compareRun && !benchmark) {
+    if(traceLines < 0 && !compareRun && !benchmark && audioDump.empty()) {
 #else
     ghc::CLI cli(argc, argv);
     std::string presetName = "schipc";
@@ -2945,10 +3403,16 @@ int main(int argc, char* argv[])
                 loadOpt |= Cadmium::LoadOptions::DontChangeOptions;
             cadmium.loadRom(romFile.front().c_str(), loadOpt);
         }
+        if(emulationThread)
+            cadmium.startEmulationThread();
+        if(!telemetryFile.empty())
+            cadmium.setTelemetryFile(telemetryFile);
         //SetTargetFPS(60);
         while (!cadmium.windowShouldClose()) {
             cadmium.updateAndDraw();
         }
+        if(!telemetryFile.empty())
+            cadmium.exportTelemetry();
 #else
         try {
             Cadmium cadmium(presetName.empty() ? nullptr : &chip8options);
@@ -3020,6 +3484,7 @@ int main(int argc, char* argv[])
             //chip8.loadRom(romFile.c_str());
         }
         octo_emulator_init(&octo, (char*)chip8.memory() + 512, 4096 - 512, &oopt, nullptr);
+        FrameTelemetry telemetry;
         int64_t i = 0;
         if(compareRun) {
             std::clog << "Engine2: C-Octo" << std::endl;
@@ -3054,7 +3519,17 @@ int main(int argc, char* argv[])
             auto startChip8 = std::chrono::steady_clock::now();
             auto ticks = uint64_t(instructions / options.instructionsPerFrame);
             for(i = 0; i < ticks; ++i) {
-                chip8.tick(options.instructionsPerFrame);
+                if(telemetryFile.empty()) {
+                    chip8.tick(options.instructionsPerFrame);
+                    continue;
+                }
+                telemetry.beginFrame();
+                {
+                    FrameTelemetry::Scope telemetryScope(telemetry, FrameTelemetry::eEMULATION);
+                    chip8.tick(options.instructionsPerFrame);
+                }
+                telemetry.addEmulationFrames(1);
+                telemetry.endFrame();
             }
             chip8.handleTimer();
             int64_t lastCycles = -1;
@@ -3070,6 +3545,37 @@ int main(int argc, char* argv[])
             std::cout << "Executed instructions: " << chip8.getCycles() << std::endl;
             std::cout << "Cadmium: " << durationChip8.count() << "us, " << int(double(chip8.getCycles())/durationChip8.count()) << "MIPS" << std::endl;
         }
+        else if(!audioDump.empty()) {
+            // frame n ends at sample (n+1) * sampleRate / frameRate, so no rounding error accumulates
+            std::vector<int16_t> samples;
+            samples.reserve(size_t(audioFrames * sampleRate / chip8.frameRate() + 1));
+            auto startRender = std::chrono::steady_clock::now();
+            for(i = 0; i < audioFrames && chip8.getExecMode() != emu::IChip8Emulator::ePAUSED; ++i) {
+                telemetry.beginFrame();
+                {
+                    FrameTelemetry::Scope telemetryScope(telemetry, FrameTelemetry::eEMULATION);
+                    chip8.tick(options.instructionsPerFrame);
+                }
+                telemetry.addEmulationFrames(1);
+                auto frameEnd = size_t((i + 1) * sampleRate / chip8.frameRate());
+                auto offset = samples.size();
+                samples.resize(frameEnd);
+                {
+                    FrameTelemetry::Scope telemetryScope(telemetry, FrameTelemetry::eAUDIO);
+                    chip8.renderAudio(samples.data() + offset, frameEnd - offset, int(sampleRate));
+                }
+                telemetry.endFrame();
+            }
+            auto durationRender = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startRender);
+            if(!emu::writeWavFile(audioDump, samples.data(), samples.size(), int(sampleRate))) {
+                std::cerr << "ERROR: could not write '" << audioDump << "'." << std::endl;
+                exit(1);
+            }
+            auto seconds = double(samples.size()) / sampleRate;
+            std::cout << "Rendered " << i << " frames (" << samples.size() << " samples, " << seconds << "s) in " << durationRender.count() / 1000 << "ms, "
+                      << int(seconds * 1000000 / std::max(int64_t(1), int64_t(durationRender.count()))) << "x realtime" << std::endl;
+            std::cout << "Audio sha1: " << calculateSha1((const uint8_t*)samples.data(), samples.size() * sizeof(int16_t)).to_hex() << std::endl;
+        }
         else if(traceLines >= 0) {
             chip8.memory()[0x1ff] = testSuiteMenuVal & 0xff;
             size_t waits = 0;
@@ -3095,6 +3601,13 @@ int main(int argc, char* argv[])
                 std::cout << chip8EmuScreenANSI(chip8);
             }
         }
+        if(!telemetryFile.empty() && telemetry.size()) {
+            if(!telemetry.exportToFile(telemetryFile)) {
+                std::cerr << "ERROR: could not write '" << telemetryFile << "'." << std::endl;
+                exit(1);
+            }
+            std::cout << "Frame timing of " << telemetry.size() << " frames written to '" << telemetryFile << "'" << std::endl;
+        }
     }
 #endif
     return 0;
@@ -34,12 +34,15 @@
 #include <chiplet/utility.hpp>
 #include <chiplet/octocartridge.hpp>
 #include <emulation/c8bfile.hpp>
+#include <emulation/mappedfile.hpp>
 #include <systemtools.hpp>
 #include <configuration.hpp>
 
 #include <raylib.h>
 #include <nlohmann/json.hpp>
 
+#include <algorithm>
+
 namespace emu {
 
 Chip8EmuHostEx::Chip8EmuHostEx()
@@ -52,6 +55,8 @@ Chip8EmuHostEx::Chip8EmuHostEx()
         _currentDirectory = _cfg.workingDirectory;
         _databaseDirectory = _cfg.databaseDirectory;
     }
+    _librarian.setCacheFile((fs::path(dataPath())/"librarian.cache").string());
+    _librarian.setThumbnailDirectory((fs::path(dataPath())/"thumbnails").string());
     _librarian.fetchDir(_currentDirectory);
 #endif
     if(_options.hasColors())
@@ -62,6 +67,13 @@ Chip8EmuHostEx::Chip8EmuHostEx()
     _defaultPalette = _colorPalette;
 }
 
+Chip8EmuHostEx::Chip8EmuHostEx(Headless)
+: _librarian(_cfg)
+{
+    setPalette({0x1a1c2cff, 0xf4f4f4ff, 0x94b0c2ff, 0x333c57ff, 0xb13e53ff, 0xa7f070ff, 0x3b5dc9ff, 0xffcd75ff, 0x5d275dff, 0x38b764ff, 0x29366fff, 0x566c86ff, 0xef7d57ff, 0x73eff7ff, 0x41a6f6ff, 0x257179ff});
+    _defaultPalette = _colorPalette;
+}
+
 void Chip8EmuHostEx::setPalette(const std::vector<uint32_t>& colors, size_t offset)
 {
     for(size_t i = 0; i < colors.size() && i + offset < _colorPalette.size(); ++i) {
@@ -206,8 +218,10 @@ bool Chip8EmuHostEx::loadRom(const char* filename, LoadOptions loadOpt)
         unsigned int size = 0;
         _customPalette = false;
         _colorPalette = _defaultPalette;
-        auto fileData = loadFile(filename, Librarian::MAX_ROM_SIZE);
-        return loadBinary(filename, fileData.data(), fileData.size(), loadOpt);
+        // headless hosts render thumbnails on background threads, possibly of files that are
+        // being rewritten, so they don't map the file to avoid SIGBUS on truncation
+        emu::MappedFile file(filename, Librarian::MAX_ROM_SIZE, isHeadless() ? emu::MappedFile::eBUFFERED : emu::MappedFile::eMAPPED);
+        return loadBinary(filename, file.data(), file.size(), loadOpt);
         //memory[0x1FF] = 3;
     }
     return false;
@@ -244,14 +258,14 @@ bool Chip8EmuHostEx::loadBinary(std::string filename, const uint8_t* data, size_
     std::string romSha1Hex;
     std::vector<uint8_t> romImage;
     std::string source;
-    auto fileData = std::vector<uint8_t>(data, data + size);
-    auto isKnown = _librarian.isKnownFile(fileData.data(), fileData.size());
+    auto fileDigest = Sha1Digest::calculate(data, size);
+    auto isKnown = _librarian.isKnownFile(fileDigest);
     bool wasFromSource = false;
-    TraceLog(LOG_INFO, "Loading %s file with sha1: %s", isKnown ? "known" : "unknown", calculateSha1(fileData.data(), fileData.size()).to_hex().c_str());
-    auto knownOptions = _librarian.getOptionsForFile(fileData.data(), fileData.size());
+    TraceLog(LOG_INFO, "Loading %s file with sha1: %s", isKnown ? "known" : "unknown", fileDigest.toHex().c_str());
+    auto knownOptions = _librarian.getOptionsForFile(fileDigest);
     if(endsWith(filename, ".8o")) {
         c8c = std::make_unique<emu::OctoCompiler>();
-        source.assign((const char*)fileData.data(), fileData.size());
+        source.assign((const char*)data, size);
         if(c8c->compile(filename).resultType == emu::CompileResult::eOK)
         {
             if(c8c->codeSize() < _chipEmu->memSize() - _options.startAddress) {
@@ -260,8 +274,8 @@ bool Chip8EmuHostEx::loadBinary(std::string filename, const uint8_t* data, size_
                 valid = true;
                 wasFromSource = true;
                 if((loadOpt & LoadOptions::DontChangeOptions) == 0) {
-                    isKnown = _librarian.isKnownFile(romImage.data(), romImage.size());
-                    knownOptions = _librarian.getOptionsForFile(romImage.data(), romImage.size());
+                    isKnown = _librarian.isKnownFile(romSha1Hex);
+                    knownOptions = _librarian.getOptionsForFile(romSha1Hex);
                     if(_options.behaviorBase != emu::Chip8EmulatorOptions::ePORTABLE && knownOptions.behaviorBase != Chip8EmulatorOptions::ePORTABLE)
                         updateEmulatorOptions(knownOptions);
                 }
@@ -274,7 +288,7 @@ bool Chip8EmuHostEx::loadBinary(std::string filename, const uint8_t* data, size_
         }
     }
     else if(endsWith(filename, ".gif")) {
-        emu::OctoCartridge cart(fileData);
+        emu::OctoCartridge cart(std::vector<uint8_t>(data, data + size));
         cart.loadCartridge();
         source = cart.getSource();
         if(!source.empty()) {
@@ -303,28 +317,28 @@ bool Chip8EmuHostEx::loadBinary(std::string filename, const uint8_t* data, size_
         if(_options.hasColors()) {
             _options.updateColors(_colorPalette);
         }
-        romImage = fileData;
+        romImage.assign(data, data + size);
         valid = true;
     }
     else if(endsWith(filename, ".ch10")) {
         if((loadOpt & LoadOptions::DontChangeOptions) == 0)
             updateEmulatorOptions(Chip8EmulatorOptions::optionsOfPreset(Chip8EmulatorOptions::eCHIP10));
         if (size < _chipEmu->memSize() - _options.startAddress) {
-            romImage = fileData;
+            romImage.assign(data, data + size);
             valid = true;
         }
     }
-    else if(endsWith(filename, ".hc8") || Librarian::isPrefixedRSTDPRom(fileData.data(), fileData.size())) {
+    else if(endsWith(filename, ".hc8") || Librarian::isPrefixedRSTDPRom(data, size)) {
         if((loadOpt & LoadOptions::DontChangeOptions) == 0)
             updateEmulatorOptions(Chip8EmulatorOptions::optionsOfPreset(Chip8EmulatorOptions::eCHIP8VIP));
         if (size < _chipEmu->memSize() - _options.startAddress) {
-            romImage = fileData;
+            romImage.assign(data, data + size);
             valid = true;
         }
     }
-    else if(endsWith(filename, ".c8tp") || Librarian::isPrefixedTPDRom(fileData.data(), fileData.size())) {
+    else if(endsWith(filename, ".c8tp") || Librarian::isPrefixedTPDRom(data, size)) {
         if (size < _chipEmu->memSize() - _options.startAddress) {
-            romImage = fileData;
+            romImage.assign(data, data + size);
             valid = true;
         }
         if((loadOpt & LoadOptions::DontChangeOptions) == 0)
@@ -332,7 +346,7 @@ bool Chip8EmuHostEx::loadBinary(std::string filename, const uint8_t* data, size_
     }
     else if(endsWith(filename, ".c8e")) {
         if (size < _chipEmu->memSize() - _options.startAddress) {
-            romImage = fileData;
+            romImage.assign(data, data + size);
             valid = true;
         }
         if((loadOpt & LoadOptions::DontChangeOptions) == 0)
@@ -340,7 +354,7 @@ bool Chip8EmuHostEx::loadBinary(std::string filename, const uint8_t* data, size_
     }
     else if(endsWith(filename, ".c8x")) {
         if (size < _chipEmu->memSize() - _options.startAddress) {
-            romImage = fileData;
+            romImage.assign(data, data + size);
             valid = true;
         }
         if((loadOpt & LoadOptions::DontChangeOptions) == 0)
@@ -350,7 +364,7 @@ bool Chip8EmuHostEx::loadBinary(std::string filename, const uint8_t* data, size_
         if((loadOpt & LoadOptions::DontChangeOptions) == 0)
             updateEmulatorOptions(Chip8EmulatorOptions::optionsOfPreset(emu::Chip8EmulatorOptions::eSCHIP11));
         if (size < _chipEmu->memSize() - _options.startAddress) {
-            romImage = fileData;
+            romImage.assign(data, data + size);
             valid = true;
         }
     }
@@ -358,7 +372,7 @@ bool Chip8EmuHostEx::loadBinary(std::string filename, const uint8_t* data, size_
         if((loadOpt & LoadOptions::DontChangeOptions) == 0)
             updateEmulatorOptions(Chip8EmulatorOptions::optionsOfPreset(emu::Chip8EmulatorOptions::eMEGACHIP));
         if (size < _chipEmu->memSize() - _options.startAddress) {
-            romImage = fileData;
+            romImage.assign(data, data + size);
             valid = true;
         }
     }
@@ -366,22 +380,22 @@ bool Chip8EmuHostEx::loadBinary(std::string filename, const uint8_t* data, size_
         if((loadOpt & LoadOptions::DontChangeOptions) == 0)
             updateEmulatorOptions(Chip8EmulatorOptions::optionsOfPreset(emu::Chip8EmulatorOptions::eXOCHIP));
         if (size < _chipEmu->memSize() - _options.startAddress) {
-            romImage = fileData;
+            romImage.assign(data, data + size);
             valid = true;
         }
     }
     else if(endsWith(filename, ".ch8")) {
-        auto estimate = _librarian.getEstimatedPresetForFile(_options.behaviorBase, fileData.data(), fileData.size());
+        auto estimate = _librarian.getEstimatedPresetForFile(_options.behaviorBase, data, size);
         if((loadOpt & LoadOptions::DontChangeOptions) == 0 && _options.behaviorBase != estimate)
             updateEmulatorOptions(Chip8EmulatorOptions::optionsOfPreset(estimate));
         if (size < _chipEmu->memSize() - _options.startAddress) {
-            romImage = fileData;
+            romImage.assign(data, data + size);
             valid = true;
         }
     }
     else if(endsWith(filename, ".c8b")) {
         C8BFile c8b;
-        if(c8b.loadFromData(fileData.data(), fileData.size()) == C8BFile::eOK) {
+        if(c8b.loadFromData(data, size) == C8BFile::eOK) {
             uint16_t codeOffset = 0;
             uint16_t codeSize = 0;
             auto iter = c8b.findBestMatch({C8BFile::C8V_XO_CHIP, C8BFile::C8V_MEGA_CHIP, C8BFile::C8V_SCHIP_1_1, C8BFile::C8V_SCHIP_1_0, C8BFile::C8V_CHIP_48, C8BFile::C8V_CHIP_10, C8BFile::C8V_CHIP_8});
@@ -441,14 +455,14 @@ bool Chip8EmuHostEx::loadBinary(std::string filename, const uint8_t* data, size_
             if ((loadOpt & LoadOptions::DontChangeOptions) == 0) {
                 updateEmulatorOptions(emu::Chip8EmulatorOptions::optionsOfPreset(Chip8EmulatorOptions::eRAWVIP));
             }
-            romImage = fileData;
+            romImage.assign(data, data + size);
             valid = true;
         }
     }
     if (valid) {
         //TraceLog(LOG_INFO, "Found a valid rom.");
         _romImage = std::move(romImage);
-        _romSha1Hex = romSha1Hex.empty() ? calculateSha1(_romImage.data(), _romImage.size()).to_hex() : romSha1Hex;
+        _romSha1Hex = romSha1Hex.empty() ? (_romImage.size() == size && std::equal(_romImage.begin(), _romImage.end(), data) ? fileDigest : Sha1Digest::calculate(_romImage.data(), _romImage.size())).toHex() : romSha1Hex;
         _romName = filename;
         _romIsWellKnown = isKnown;
         if(isKnown && knownOptions.behaviorBase != Chip8EmulatorOptions::ePORTABLE)
@@ -468,12 +482,12 @@ bool Chip8EmuHostEx::loadBinary(std::string filename, const uint8_t* data, size_
         }
         //TraceLog(LOG_INFO, "Done with palette.");
         auto p = fs::path(_romName).parent_path();
-        if(fs::exists(p) && fs::is_directory(p))  {
+        if(!isHeadless() && fs::exists(p) && fs::is_directory(p))  {
             _currentDirectory = fs::path(_romName).parent_path().string();
             _librarian.fetchDir(_currentDirectory);
         }
         //TraceLog(LOG_INFO, "Done with directory change.");
-        if(!wasFromSource && _romImage.size() < 8192*1024) {
+        if(!wasFromSource && !isHeadless() && _romImage.size() < 8192*1024) {
             //TraceLog(LOG_INFO, "Setting up decompiler.");
             std::stringstream os;
             //TraceLog(LOG_INFO, "Setting instance.");
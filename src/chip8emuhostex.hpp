@@ -75,8 +75,12 @@ public:
     virtual bool loadBinary(std::string filename, const uint8_t* data, size_t size, LoadOptions loadOpt);
     void updateEmulatorOptions(const Chip8EmulatorOptions& options);
     void setPalette(const std::vector<uint32_t>& colors, size_t offset = 0);
+    const std::array<uint32_t, 256>& defaultPalette() const { return _defaultPalette; }
 
 protected:
+    // headless hosts neither load the configuration nor scan any directories
+    struct Headless {};
+    explicit Chip8EmuHostEx(Headless);
     std::unique_ptr<IChip8Emulator> create(Chip8EmulatorOptions& options, IChip8Emulator* iother = nullptr);
     virtual void whenRomLoaded(const std::string& filename, bool autoRun, emu::OctoCompiler* compiler, const std::string& source) {}
     virtual void whenEmuChanged(IChip8Emulator& emu) {}
@@ -104,8 +108,8 @@ GHC_ENUM_ENABLE_BIT_OPERATIONS(Chip8EmuHostEx::LoadOptions)
 class Chip8HeadlessHost : public Chip8EmuHostEx
 {
 public:
-    Chip8HeadlessHost() = default;
-    explicit Chip8HeadlessHost(Chip8EmulatorOptions& opts) { updateEmulatorOptions(opts); }
+    Chip8HeadlessHost() : Chip8EmuHostEx(Headless{}) {}
+    explicit Chip8HeadlessHost(Chip8EmulatorOptions& opts) : Chip8EmuHostEx(Headless{}) { updateEmulatorOptions(opts); }
     ~Chip8HeadlessHost() override = default;
     Chip8EmulatorOptions& options() { return _options; }
     IChip8Emulator& chipEmu() { return *_chipEmu; }
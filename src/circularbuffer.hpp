@@ -25,6 +25,9 @@
 //---------------------------------------------------------------------------------------
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <cstddef>
 #include <cstdint>
 #include <memory>
@@ -77,3 +80,87 @@ public:
         return writeInto(source, frames * FRAME_SIZE) / FRAME_SIZE;
     }
 };
+
+//---------------------------------------------------------------------------------------
+// Wait-free single producer/single consumer ring, the storage is part of the object, so
+// neither side allocates or locks, making it safe to read from an audio callback. The
+// indices grow monotonically and live on their own cache lines, so producer and consumer
+// don't invalidate each others lines on every access.
+//---------------------------------------------------------------------------------------
+template<typename T, size_t Capacity>
+class SpscRingBuffer
+{
+public:
+    static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+    static constexpr size_t CACHE_LINE_SIZE = 64;
+
+    // Samples the consumer will still get, those dropped by reset() but not yet skipped
+    // by the consumer don't count
+    size_t dataAvailable() const
+    {
+        auto readIndex = _readIndex.load(std::memory_order_acquire);
+        auto writeIndex = _writeIndex.load(std::memory_order_acquire);
+        auto discardIndex = _discardIndex.load(std::memory_order_acquire);
+        if (discardIndex - readIndex <= writeIndex - readIndex) {
+            readIndex = discardIndex;
+        }
+        return writeIndex - readIndex;
+    }
+
+    // Samples the producer can write right now, discarded samples only free their space
+    // once the consumer skipped them
+    size_t spaceAvailable() const
+    {
+        return Capacity - (_writeIndex.load(std::memory_order_acquire) - _readIndex.load(std::memory_order_acquire));
+    }
+
+    uint64_t underruns() const { return _underruns.load(std::memory_order_relaxed); }
+
+    // Producer side only: drops everything written so far, the consumer skips it on its next read
+    void reset()
+    {
+        _discardIndex.store(_writeIndex.load(std::memory_order_relaxed), std::memory_order_release);
+    }
+
+    // Producer side only
+    size_t write(const T* source, size_t count)
+    {
+        auto writeIndex = _writeIndex.load(std::memory_order_relaxed);
+        auto readIndex = _readIndex.load(std::memory_order_acquire);
+        count = std::min(count, Capacity - (writeIndex - readIndex));
+        auto offset = writeIndex & (Capacity - 1);
+        auto first = std::min(count, Capacity - offset);
+        std::copy(source, source + first, _buffer.data() + offset);
+        std::copy(source + first, source + count, _buffer.data());
+        _writeIndex.store(writeIndex + count, std::memory_order_release);
+        return count;
+    }
+
+    // Consumer side only, a read that can't be satisfied completely counts as underrun
+    size_t read(T* destination, size_t count)
+    {
+        auto readIndex = _readIndex.load(std::memory_order_relaxed);
+        auto writeIndex = _writeIndex.load(std::memory_order_acquire);
+        auto discardIndex = _discardIndex.load(std::memory_order_acquire);
+        if (discardIndex - readIndex <= writeIndex - readIndex) {
+            readIndex = discardIndex;
+        }
+        if (count > writeIndex - readIndex) {
+            count = writeIndex - readIndex;
+            _underruns.fetch_add(1, std::memory_order_relaxed);
+        }
+        auto offset = readIndex & (Capacity - 1);
+        auto first = std::min(count, Capacity - offset);
+        std::copy(_buffer.data() + offset, _buffer.data() + offset + first, destination);
+        std::copy(_buffer.data(), _buffer.data() + count - first, destination + first);
+        _readIndex.store(readIndex + count, std::memory_order_release);
+        return count;
+    }
+
+private:
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> _writeIndex{0};
+    std::atomic<size_t> _discardIndex{0};
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> _readIndex{0};
+    std::atomic<uint64_t> _underruns{0};
+    alignas(CACHE_LINE_SIZE) std::array<T, Capacity> _buffer{};
+};
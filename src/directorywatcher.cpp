@@ -0,0 +1,210 @@
+//---------------------------------------------------------------------------------------
+// src/directorywatcher.cpp
+//---------------------------------------------------------------------------------------
+//
+// Copyright (c) 2023, Steffen Schümann <s.schuemann@pobox.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//---------------------------------------------------------------------------------------
+#include <directorywatcher.hpp>
+
+#include <ghc/filesystem.hpp>
+
+#include <algorithm>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <cerrno>
+#define CADMIUM_WITH_INOTIFY
+#endif
+
+namespace fs = ghc::filesystem;
+
+DirectoryWatcher::~DirectoryWatcher()
+{
+    stop();
+}
+
+bool DirectoryWatcher::watch(const std::string& directory)
+{
+    stop();
+    std::error_code ec;
+    if(!fs::is_directory(directory, ec))
+        return false;
+    _directory = directory;
+#ifdef CADMIUM_WITH_INOTIFY
+    // the watch is added before listing, so changes during the listing are not lost
+    _inotifyFd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if(_inotifyFd >= 0) {
+        _watchDescriptor = ::inotify_add_watch(_inotifyFd, directory.c_str(), IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_CLOSE_WRITE | IN_ATTRIB | IN_DELETE_SELF | IN_MOVE_SELF);
+        if(_watchDescriptor < 0) {
+            ::close(_inotifyFd);
+            _inotifyFd = -1;
+        }
+    }
+#endif
+    _snapshot = listDirectory();
+    _nextPoll = std::chrono::steady_clock::now() + _pollingInterval;
+    return true;
+}
+
+void DirectoryWatcher::stop()
+{
+#ifdef CADMIUM_WITH_INOTIFY
+    if(_inotifyFd >= 0) {
+        ::close(_inotifyFd);  // also removes the watch
+        _inotifyFd = -1;
+        _watchDescriptor = -1;
+    }
+#endif
+    _directory.clear();
+    _snapshot.clear();
+}
+
+std::vector<DirectoryWatcher::Event> DirectoryWatcher::poll()
+{
+    std::vector<Event> events;
+    if(_directory.empty())
+        return events;
+    if(isNative()) {
+        std::vector<std::string> names;
+        bool directoryGone = false;
+        if(!readNativeEvents(names, directoryGone) || directoryGone) {
+            // events were dropped or the directory is gone, comparing the snapshot catches up
+            diffSnapshot(events);
+        }
+        else {
+            // several events for the same name (create, modify, close) are reported once
+            for(const auto& name : names)
+                updateEntry(name, events);
+        }
+        if(directoryGone)
+            stop();
+        return events;
+    }
+    auto now = std::chrono::steady_clock::now();
+    if(now >= _nextPoll) {
+        _nextPoll = now + _pollingInterval;
+        diffSnapshot(events);
+    }
+    return events;
+}
+
+DirectoryWatcher::Snapshot DirectoryWatcher::listDirectory() const
+{
+    Snapshot snapshot;
+    std::error_code ec;
+    for(auto iter = fs::directory_iterator(_directory, ec); !ec && iter != fs::directory_iterator(); iter.increment(ec)) {
+        Entry entry;
+        if(statEntry(iter->path().filename().string(), entry))
+            snapshot.emplace(iter->path().filename().string(), entry);
+    }
+    return snapshot;
+}
+
+bool DirectoryWatcher::statEntry(const std::string& name, Entry& entry) const
+{
+    std::error_code ec;
+    auto path = fs::path(_directory) / name;
+    auto status = fs::status(path, ec);
+    if(ec || (!fs::is_directory(status) && !fs::is_regular_file(status)))
+        return false;
+    entry.isDirectory = fs::is_directory(status);
+    entry.size = entry.isDirectory ? 0 : uint64_t(fs::file_size(path, ec));
+    entry.time = int64_t(fs::last_write_time(path, ec).time_since_epoch().count());
+    return true;
+}
+
+// Compares the state of a single entry with the snapshot and reports the difference
+void DirectoryWatcher::updateEntry(const std::string& name, std::vector<Event>& events)
+{
+    Entry entry;
+    bool exists = statEntry(name, entry);
+    auto iter = _snapshot.find(name);
+    if(iter == _snapshot.end()) {
+        if(exists) {
+            _snapshot.emplace(name, entry);
+            events.push_back({eADDED, name, entry.isDirectory});
+        }
+    }
+    else if(!exists) {
+        events.push_back({eREMOVED, name, iter->second.isDirectory});
+        _snapshot.erase(iter);
+    }
+    else if(iter->second.isDirectory != entry.isDirectory) {
+        events.push_back({eREMOVED, name, iter->second.isDirectory});
+        events.push_back({eADDED, name, entry.isDirectory});
+        iter->second = entry;
+    }
+    else if(iter->second.size != entry.size || iter->second.time != entry.time) {
+        iter->second = entry;
+        events.push_back({eMODIFIED, name, entry.isDirectory});
+    }
+}
+
+void DirectoryWatcher::diffSnapshot(std::vector<Event>& events)
+{
+    auto current = listDirectory();
+    for(const auto& [name, entry] : _snapshot) {
+        if(!current.count(name))
+            events.push_back({eREMOVED, name, entry.isDirectory});
+    }
+    for(const auto& [name, entry] : current) {
+        auto iter = _snapshot.find(name);
+        if(iter == _snapshot.end())
+            events.push_back({eADDED, name, entry.isDirectory});
+        else if(iter->second.isDirectory != entry.isDirectory) {
+            events.push_back({eREMOVED, name, iter->second.isDirectory});
+            events.push_back({eADDED, name, entry.isDirectory});
+        }
+        else if(iter->second.size != entry.size || iter->second.time != entry.time)
+            events.push_back({eMODIFIED, name, entry.isDirectory});
+    }
+    _snapshot = std::move(current);
+}
+
+// Collects the names of changed entries, returns false if the kernel queue overflowed
+// and changes might have been lost
+bool DirectoryWatcher::readNativeEvents(std::vector<std::string>& names, bool& directoryGone)
+{
+#ifdef CADMIUM_WITH_INOTIFY
+    alignas(struct inotify_event) char buffer[16384];
+    bool complete = true;
+    while(true) {
+        auto length = ::read(_inotifyFd, buffer, sizeof(buffer));
+        if(length <= 0)
+            break;
+        for(char* ptr = buffer; ptr < buffer + length; ) {
+            const auto* event = reinterpret_cast<const struct inotify_event*>(ptr);
+            ptr += sizeof(struct inotify_event) + event->len;
+            if(event->mask & IN_Q_OVERFLOW)
+                complete = false;
+            else if(event->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED))
+                directoryGone = true;
+            else if(event->len && std::find(names.begin(), names.end(), event->name) == names.end())
+                names.emplace_back(event->name);
+        }
+    }
+    return complete;
+#else
+    return true;
+#endif
+}
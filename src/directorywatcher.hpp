@@ -0,0 +1,86 @@
+//---------------------------------------------------------------------------------------
+// src/directorywatcher.hpp
+//---------------------------------------------------------------------------------------
+//
+// Copyright (c) 2023, Steffen Schümann <s.schuemann@pobox.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//---------------------------------------------------------------------------------------
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+//---------------------------------------------------------------------------------------
+// Watches a single directory (not recursive) and reports the names of entries that were
+// added, modified or removed since the last poll(). On Linux this uses inotify, other
+// platforms, and Linux when inotify is unavailable or its queue overflowed, compare a
+// snapshot of the directory, re-listed at most once per polling interval.
+//---------------------------------------------------------------------------------------
+class DirectoryWatcher
+{
+public:
+    enum Change { eADDED, eMODIFIED, eREMOVED };
+    struct Event
+    {
+        Change change;
+        std::string name;
+        bool isDirectory;
+    };
+    struct Entry
+    {
+        bool isDirectory{false};
+        uint64_t size{0};
+        int64_t time{0};  // last write time in ticks of the filesystem clock
+    };
+    using Snapshot = std::unordered_map<std::string, Entry>;
+    DirectoryWatcher() = default;
+    ~DirectoryWatcher();
+    DirectoryWatcher(const DirectoryWatcher&) = delete;
+    DirectoryWatcher& operator=(const DirectoryWatcher&) = delete;
+
+    // Starts watching the directory, replacing the previous one, its current content is the baseline
+    bool watch(const std::string& directory);
+    // The known entries, right after watch() the baseline, so callers never need a listing of their own
+    const Snapshot& entries() const { return _snapshot; }
+    void stop();
+    const std::string& directory() const { return _directory; }
+    bool isWatching() const { return !_directory.empty(); }
+    bool isNative() const { return _inotifyFd >= 0; }
+    void setPollingInterval(std::chrono::milliseconds interval) { _pollingInterval = interval; }
+    // Collects the changes since the last call, never blocks
+    std::vector<Event> poll();
+
+private:
+    Snapshot listDirectory() const;
+    bool statEntry(const std::string& name, Entry& entry) const;
+    void updateEntry(const std::string& name, std::vector<Event>& events);
+    void diffSnapshot(std::vector<Event>& events);
+    bool readNativeEvents(std::vector<std::string>& names, bool& directoryGone);
+    std::string _directory;
+    Snapshot _snapshot;
+    std::chrono::milliseconds _pollingInterval{2000};
+    std::chrono::steady_clock::time_point _nextPoll{};
+    int _inotifyFd{-1};
+    int _watchDescriptor{-1};
+};
@@ -32,6 +32,7 @@
 #include <cmath>
 #include <regex>
 #include <editor.hpp>
+#include <sha1digest.hpp>
 #include <chiplet/utility.hpp>
 #include <chiplet/octocompiler.hpp>
 #include <ghc/utf8.hpp>
@@ -418,7 +419,7 @@ void Editor::update()
         _inactiveEditTimer += GetFrameTime();
         if(_inactiveEditTimer > INACTIVITY_DELAY) {
             _inactiveEditTimer = 0;
-            _editedTextSha1Hex = calculateSha1(_text).to_hex();
+            _editedTextSha1Hex = Sha1Digest::calculate((const uint8_t*)_text.data(), _text.size()).toHex();
             if(_editedTextSha1Hex != _compiledSourceSha1Hex) {
                 _compiledSourceSha1Hex = _editedTextSha1Hex;
                 recompile();
@@ -26,8 +26,11 @@
 
 #include <emulation/chip8cores.hpp>
 #include <emulation/logger.hpp>
+#include <emulation/oscillator.hpp>
+#include <emulation/simd.hpp>
 
 #include <iostream>
+#include <iterator>
 #include <nlohmann/json.hpp>
 
 //#define ALIEN_INV8SION_BENCH
@@ -478,7 +481,7 @@ void Chip8EmulatorFP::op0010(uint16_t opcode)
 
 void Chip8EmulatorFP::op0011(uint16_t opcode)
 {
-    _isMegaChipMode = true;
+    enterMegaChipMode();
     _host.preClear();
     clearScreen();
     ++_clearCounter;
@@ -1239,6 +1242,124 @@ static void blendColorsMul(uint32_t* dest, const uint32_t* col)
     *dst = 255;
 }
 
+template<Chip8EmulatorBase::MegaChipBlendMode blendMode>
+static inline void blendPixel(uint32_t* dest, const uint32_t* col)
+{
+    if constexpr (blendMode == Chip8EmulatorBase::eBLEND_ALPHA_25)
+        blendColorsAlpha(dest, col, 63);
+    else if constexpr (blendMode == Chip8EmulatorBase::eBLEND_ALPHA_50)
+        blendColorsAlpha(dest, col, 127);
+    else if constexpr (blendMode == Chip8EmulatorBase::eBLEND_ALPHA_75)
+        blendColorsAlpha(dest, col, 191);
+    else if constexpr (blendMode == Chip8EmulatorBase::eBLEND_ADD)
+        blendColorsAdd(dest, col);
+    else if constexpr (blendMode == Chip8EmulatorBase::eBLEND_MUL)
+        blendColorsMul(dest, col);
+    else
+        *dest = *col;
+}
+
+#ifdef CADMIUM_WITH_SSE2
+// Four pixel version of blendPixel, results are bit identical to the scalar functions
+template<Chip8EmulatorBase::MegaChipBlendMode blendMode>
+static inline __m128i blendPixels4(__m128i dst, __m128i col)
+{
+    const auto alphaMask = _mm_set1_epi32(int(0xFF000000));
+    if constexpr (blendMode == Chip8EmulatorBase::eBLEND_NORMAL) {
+        return col;
+    }
+    else if constexpr (blendMode == Chip8EmulatorBase::eBLEND_ADD) {
+        return _mm_or_si128(_mm_adds_epu8(dst, col), alphaMask);
+    }
+    else {
+        const auto zero = _mm_setzero_si128();
+        auto dstLo = _mm_unpacklo_epi8(dst, zero);
+        auto dstHi = _mm_unpackhi_epi8(dst, zero);
+        auto colLo = _mm_unpacklo_epi8(col, zero);
+        auto colHi = _mm_unpackhi_epi8(col, zero);
+        __m128i resLo, resHi;
+        if constexpr (blendMode == Chip8EmulatorBase::eBLEND_MUL) {
+            // exact x/255 for x <= 255*255: (x + 1 + (x >> 8)) >> 8
+            const auto one = _mm_set1_epi16(1);
+            auto prodLo = _mm_mullo_epi16(dstLo, colLo);
+            auto prodHi = _mm_mullo_epi16(dstHi, colHi);
+            resLo = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(prodLo, one), _mm_srli_epi16(prodLo, 8)), 8);
+            resHi = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(prodHi, one), _mm_srli_epi16(prodHi, 8)), 8);
+        }
+        else {
+            constexpr int alpha = blendMode == Chip8EmulatorBase::eBLEND_ALPHA_25 ? 63 : blendMode == Chip8EmulatorBase::eBLEND_ALPHA_50 ? 127 : 191;
+            const auto va = _mm_set1_epi16(alpha);
+            const auto vna = _mm_set1_epi16(255 - alpha);
+            resLo = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(colLo, va), _mm_mullo_epi16(dstLo, vna)), 8);
+            resHi = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(colHi, va), _mm_mullo_epi16(dstHi, vna)), 8);
+        }
+        return _mm_or_si128(_mm_packus_epi16(resLo, resHi), alphaMask);
+    }
+}
+#endif
+
+//---------------------------------------------------------------------------------------
+// Draws one clipped row of a MegaChip sprite into the indexed and the RGBA work screen,
+// returns true if a pixel of the collision color was overwritten
+//---------------------------------------------------------------------------------------
+template<Chip8EmulatorBase::MegaChipBlendMode blendMode>
+static bool drawMegaChipSpriteRow(const uint8_t* sprite, uint8_t* indexed, uint32_t* rgba, int count, const uint32_t* palette, uint8_t collisionColor)
+{
+    bool collision = false;
+    int x = 0;
+#ifdef CADMIUM_WITH_SSE2
+    const auto zero = _mm_setzero_si128();
+    const auto collisionCol = _mm_set1_epi8(char(collisionColor));
+    for (; x + 8 <= count; x += 8) {
+        auto cols = _mm_loadl_epi64((const __m128i*)(sprite + x));
+        auto transparent = _mm_cmpeq_epi8(cols, zero);
+        auto opaqueBits = ~_mm_movemask_epi8(transparent) & 0xFF;
+        if (!opaqueBits)
+            continue;
+        auto idx = _mm_loadl_epi64((const __m128i*)(indexed + x));
+        if (_mm_movemask_epi8(_mm_andnot_si128(transparent, _mm_cmpeq_epi8(idx, collisionCol))))
+            collision = true;
+        _mm_storel_epi64((__m128i*)(indexed + x), simd::select(transparent, idx, cols));
+        const auto* col = sprite + x;
+        if (opaqueBits & 0x0F) {
+            auto dst = _mm_loadu_si128((const __m128i*)(rgba + x));
+            auto src = _mm_set_epi32(int(palette[col[3]]), int(palette[col[2]]), int(palette[col[1]]), int(palette[col[0]]));
+            _mm_storeu_si128((__m128i*)(rgba + x), simd::select(simd::expandByteMaskLo(transparent), dst, blendPixels4<blendMode>(dst, src)));
+        }
+        if (opaqueBits & 0xF0) {
+            auto dst = _mm_loadu_si128((const __m128i*)(rgba + x + 4));
+            auto src = _mm_set_epi32(int(palette[col[7]]), int(palette[col[6]]), int(palette[col[5]]), int(palette[col[4]]));
+            _mm_storeu_si128((__m128i*)(rgba + x + 4), simd::select(simd::expandByteMaskHi(transparent), dst, blendPixels4<blendMode>(dst, src)));
+        }
+    }
+#endif
+    for (; x < count; ++x) {
+        auto col = sprite[x];
+        if (col) {
+            if (indexed[x] == collisionColor)
+                collision = true;
+            indexed[x] = col;
+            blendPixel<blendMode>(rgba + x, palette + col);
+        }
+    }
+    return collision;
+}
+
+using MegaChipSpriteRowFunc = bool (*)(const uint8_t*, uint8_t*, uint32_t*, int, const uint32_t*, uint8_t);
+
+static MegaChipSpriteRowFunc megaChipSpriteRowFunc(Chip8EmulatorBase::MegaChipBlendMode blendMode)
+{
+    switch (blendMode) {
+        case Chip8EmulatorBase::eBLEND_ALPHA_25: return drawMegaChipSpriteRow<Chip8EmulatorBase::eBLEND_ALPHA_25>;
+        case Chip8EmulatorBase::eBLEND_ALPHA_50: return drawMegaChipSpriteRow<Chip8EmulatorBase::eBLEND_ALPHA_50>;
+        case Chip8EmulatorBase::eBLEND_ALPHA_75: return drawMegaChipSpriteRow<Chip8EmulatorBase::eBLEND_ALPHA_75>;
+        case Chip8EmulatorBase::eBLEND_ADD: return drawMegaChipSpriteRow<Chip8EmulatorBase::eBLEND_ADD>;
+        case Chip8EmulatorBase::eBLEND_MUL: return drawMegaChipSpriteRow<Chip8EmulatorBase::eBLEND_MUL>;
+        case Chip8EmulatorBase::eBLEND_NORMAL:
+        default: return drawMegaChipSpriteRow<Chip8EmulatorBase::eBLEND_NORMAL>;
+    }
+}
+
 void Chip8EmulatorFP::opDxyn_megaChip(uint16_t opcode)
 {
     if(!_isMegaChipMode)
@@ -1270,6 +1391,8 @@ void Chip8EmulatorFP::opDxyn_megaChip(uint16_t opcode)
             }
         }
         else {
+            auto drawRow = megaChipSpriteRowFunc(_blendMode);
+            int width = std::min<int>(_spriteWidth, 256 - xpos);
             for (int y = 0; y < _spriteHeight; ++y) {
                 int yy = ypos + y;
                 if(_options.optWrapSprites) {
@@ -1281,48 +1404,14 @@ void Chip8EmulatorFP::opDxyn_megaChip(uint16_t opcode)
                     if(yy >= 192)
                         break;
                 }
-                uint8_t* pixelBuffer = &_screen.getPixelRef(xpos, yy);
-                uint32_t* pixelBuffer32 = &_workRGBA->getPixelRef(xpos, yy);
-                for (int x = 0; x < _spriteWidth; ++x, ++pixelBuffer, ++pixelBuffer32) {
-                    int xx = xpos + x;
-                    if(xx > 255) {
-                        if(_options.optWrapSprites) {
-                            xx &= 0xff;
-                            pixelBuffer = &_screen.getPixelRef(xx, yy);
-                            pixelBuffer32 = &_workRGBA->getPixelRef(xx, yy);
-                        }
-                        else {
-                            continue;
-                        }
-                    }
-                    auto col = _memory[_rI + y * _spriteWidth + x];
-                    if (col) {
-                        if (*pixelBuffer == _collisionColor)
-                            _rV[0xF] = 1;
-                        *pixelBuffer = col;
-                        switch (_blendMode) {
-                            case Chip8EmulatorBase::eBLEND_ALPHA_25:
-                                blendColorsAlpha(pixelBuffer32, &_mcPalette[col], 63);
-                                break;
-                            case Chip8EmulatorBase::eBLEND_ALPHA_50:
-                                blendColorsAlpha(pixelBuffer32, &_mcPalette[col], 127);
-                                break;
-                            case Chip8EmulatorBase::eBLEND_ALPHA_75:
-                                blendColorsAlpha(pixelBuffer32, &_mcPalette[col], 191);
-                                break;
-                            case Chip8EmulatorBase::eBLEND_ADD:
-                                blendColorsAdd(pixelBuffer32, &_mcPalette[col]);
-                                break;
-                            case Chip8EmulatorBase::eBLEND_MUL:
-                                blendColorsMul(pixelBuffer32, &_mcPalette[col]);
-                                break;
-                            case Chip8EmulatorBase::eBLEND_NORMAL:
-                            default:
-                                *pixelBuffer32 = _mcPalette[col];
-                                break;
-                        }
-                    }
+                const uint8_t* spriteRow = _memory.data() + _rI + y * _spriteWidth;
+                bool collision = drawRow(spriteRow, &_screen.getPixelRef(xpos, yy), &_workRGBA->getPixelRef(xpos, yy), width, _mcPalette.data(), _collisionColor);
+                if(_options.optWrapSprites && _spriteWidth > width) {
+                    // the part right of the border continues at column 0 of the same line
+                    collision |= drawRow(spriteRow + width, &_screen.getPixelRef(0, yy), &_workRGBA->getPixelRef(0, yy), _spriteWidth - width, _mcPalette.data(), _collisionColor);
                 }
+                if(collision)
+                    _rV[0xF] = 1;
             }
         }
     }
@@ -1630,26 +1719,21 @@ void Chip8EmulatorFP::renderAudio(int16_t* samples, size_t frames, int sampleFre
     }
     else if(_rST) {
         if (_options.optXOChipSound) {
-            auto step = 4000 * std::pow(2.0f, (float(_xoPitch) - 64) / 48.0f) / 128 / sampleFrequency;
-            for (int i = 0; i < frames; ++i) {
-                auto pos = int(std::clamp(_wavePhase * 128.0f, 0.0f, 127.0f));
-                *samples++ = _xoAudioPattern[pos >> 3] & (1 << (7 - (pos & 7))) ? 16384 : -16384;
-                _wavePhase = std::fmod(_wavePhase + step, 1.0f);
-            }
+            auto frequency = 4000 * std::pow(2.0, (double(_xoPitch) - 64) / 48.0) / 128;
+            _xoPatternTables.render(samples, frames, _wavePhase, oscillator::phaseStep(frequency, sampleFrequency), _xoAudioPattern.data());
         }
         else if(_options.behaviorBase >= Chip8EmulatorOptions::eCHIP48 && _options.behaviorBase <= Chip8EmulatorOptions::eSCHPC) {
+            // the sampled HP48 beep is played back at one table entry per sample
+            _wavePhase %= std::size(g_hp48Wave);
             for (int i = 0; i < frames; ++i) {
-                *samples++ = g_hp48Wave[(int)_wavePhase];
-                _wavePhase = std::fmod(_wavePhase + 1, sizeof(g_hp48Wave) / 2);
+                *samples++ = g_hp48Wave[_wavePhase];
+                if(++_wavePhase == std::size(g_hp48Wave))
+                    _wavePhase = 0;
             }
         }
         else {
             auto audioFrequency = _options.behaviorBase == Chip8EmulatorOptions::eCHIP8X ? 27535.0f / ((unsigned)_vp595Frequency + 1) : 1531.555f;
-            const float step = audioFrequency / sampleFrequency;
-            for (int i = 0; i < frames; ++i) {
-                *samples++ = (_wavePhase > 0.5f) ? 16384 : -16384;
-                _wavePhase = std::fmod(_wavePhase + step, 1.0f);
-            }
+            oscillator::renderSquare(samples, frames, _wavePhase, oscillator::phaseStep(audioFrequency, sampleFrequency));
         }
     }
     else {
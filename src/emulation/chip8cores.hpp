@@ -37,6 +37,7 @@
 #include <chiplet/chip8meta.hpp>
 #include <emulation/chip8options.hpp>
 #include <emulation/chip8emulatorbase.hpp>
+#include <emulation/oscillator.hpp>
 #include <emulation/time.hpp>
 
 namespace emu
@@ -60,6 +61,8 @@ public:
         : Chip8EmulatorBase(host, options, other)
     {
         _memory.resize(MEMORY_SIZE, 0);
+        // drawSprite wraps on the maximum screen size, so this core needs the full buffer
+        _screen.setBufferSize(MAX_SCREEN_WIDTH, MAX_SCREEN_HEIGHT);
     }
     ~Chip8Emulator() override = default;
 
@@ -835,6 +838,7 @@ private:
     uint32_t _simpleRandState{12345};
     int _chip8xBackgroundColor{0};
     uint8_t _vp595Frequency{0x80};
+    oscillator::PatternTableCache _xoPatternTables;
 #ifdef GEN_OPCODE_STATS
     std::map<uint16_t,int64_t> _opcodeStats;
 #endif
@@ -28,6 +28,7 @@
 #include <emulation/logger.hpp>
 #include <emulation/hardware/mc682x.hpp>
 #include <emulation/hardware/keymatrix.hpp>
+#include <emulation/oscillator.hpp>
 #include <chiplet/utility.hpp>
 #include <ghc/random.hpp>
 
@@ -82,7 +83,7 @@ public:
     bool _lowFreq{true};
     int64_t _irqStart{0};
     int64_t _nextFrame{0};
-    std::atomic<float> _wavePhase{0};
+    std::atomic<uint32_t> _wavePhase{0};
     std::vector<uint8_t> _ram{};
     std::array<uint8_t,1024> _rom{};
     IChip8Emulator::VideoType _screen;
@@ -497,11 +498,9 @@ void Chip8Dream::setAudioPhase(float phase)
 void Chip8Dream::renderAudio(int16_t* samples, size_t frames, int sampleFrequency)
 {
     if(_impl->_soundEnabled) {
-        const float step = (_impl->_lowFreq ? 1200.0f : 2400.0f) / sampleFrequency;
-        for (int i = 0; i < frames; ++i) {
-            *samples++ = (_impl->_wavePhase > 0.5f) ? 16384 : -16384;
-            _impl->_wavePhase = std::fmod(_impl->_wavePhase + step, 1.0f);
-        }
+        uint32_t phase = _impl->_wavePhase;
+        oscillator::renderSquare(samples, frames, phase, oscillator::phaseStep(_impl->_lowFreq ? 1200.0 : 2400.0, sampleFrequency));
+        _impl->_wavePhase = phase;
     }
     else {
         // Default is silence
@@ -29,6 +29,10 @@
 #include <emulation/logger.hpp>
 #include <emulation/properties.hpp>
 
+#include <algorithm>
+#include <chrono>
+#include <climits>
+
 namespace emu {
 
 static uint8_t g_chip8VipFont[] = {
@@ -412,29 +416,48 @@ int64_t Chip8EmulatorBase::executeFor(int64_t micros)
         return excessTime;// > 0 ? excessTime : 0;
     }
     else {
-        using namespace std::chrono;
         handleTimer();
-        auto start = _cycleCounter;
-        auto endTime = steady_clock::now() + microseconds(micros > 2000 ? micros * 3 / 4 : 0);
-        do {
-            executeInstructions(487);
-        }
-        while(_execMode != ePAUSED && steady_clock::now() < endTime);
-        uint32_t actualIPF = _cycleCounter - start;
-        _systemTime.setFrequency((_systemTime.getClockFreq() + actualIPF)>>1);
+        executeUnlimited(micros > 2000 ? micros * 3 / 4 : 0);
     }
     return 0;
 }
 
+//---------------------------------------------------------------------------------------
+// Unlimited speed: the batches are sized from the measured instructions per microsecond,
+// each one covers three quarters of the remaining time and the last one all of it, so
+// the clock is only read a handful of times per frame and the budget is met closely,
+// the achieved rate is reported as the frequency of the system time
+//---------------------------------------------------------------------------------------
+void Chip8EmulatorBase::executeUnlimited(int64_t micros)
+{
+    using namespace std::chrono;
+    static constexpr int64_t MIN_BATCH = 64;
+    auto start = steady_clock::now();
+    auto end = start + microseconds(micros);
+    auto startCycles = _cycleCounter;
+    auto now = start;
+    do {
+        auto remaining_us = duration<double, std::micro>(end - now).count();
+        auto batch = int64_t(_instructionsPerMicro * (remaining_us > 500 ? remaining_us * 3 / 4 : remaining_us));
+        auto batchStart = _cycleCounter;
+        executeInstructions(int(std::clamp(batch, MIN_BATCH, int64_t(INT32_MAX))));
+        auto batchEnd = steady_clock::now();
+        auto elapsed_us = duration<double, std::micro>(batchEnd - now).count();
+        if(elapsed_us > 20)
+            _instructionsPerMicro = (_instructionsPerMicro + (_cycleCounter - batchStart) / elapsed_us) / 2;
+        now = batchEnd;
+    }
+    while(_execMode != ePAUSED && now < end);
+    auto total_us = duration<double, std::micro>(now - start).count();
+    if(total_us > 0)
+        _systemTime.setFrequency(uint32_t(std::min((_cycleCounter - startCycles) * 1000000.0 / total_us, double(UINT32_MAX))));
+}
+
 void Chip8EmulatorBase::tick(int instructionsPerFrame)
 {
     if(!instructionsPerFrame) {
         handleTimer();
-        auto start = std::chrono::steady_clock::now();
-        do {
-            executeInstructions(487);
-        }
-        while(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count() < 12);
+        executeUnlimited(12000);
     }
     else {
         auto instructionsLeft = calcNextFrame() - _cycleCounter;
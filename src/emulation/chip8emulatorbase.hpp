@@ -117,7 +117,10 @@ public:
         if(!_isHires && _options.optOnlyHires) {
             _isHires = true;
         }
-        _isMegaChipMode = (_options.behaviorBase == Chip8EmulatorOptions::eMEGACHIP && other && other->_isMegaChipMode);
+        _screen.setBufferSize(maxScreenWidth(options), maxScreenHeight(options));
+        if(_options.behaviorBase == Chip8EmulatorOptions::eMEGACHIP && other && other->_isMegaChipMode) {
+            enterMegaChipMode();
+        }
         _labelOrAddress = [](uint16_t addr){ return fmt::format("0x{:04X}", addr); };
         _screenRGBA = &_screenRGBA1;
         _workRGBA = &_screenRGBA2;
@@ -291,8 +294,20 @@ public:
     static std::pair<const uint8_t*, size_t> bigFontData(Chip8BigFont font = Chip8BigFont::C8F10_SCHIP11);
 
 protected:
+    void executeUnlimited(int64_t micros);
     inline int instructionsPerFrame() const { return _options.instructionsPerFrame ? _options.instructionsPerFrame : _systemTime.getClockFreq() / _options.frameRate; }
     virtual int64_t calcNextFrame() const { return ((_cycleCounter + _options.instructionsPerFrame) / _options.instructionsPerFrame) * _options.instructionsPerFrame; }
+    static int maxScreenWidth(const Chip8EmulatorOptions& options) { return options.behaviorBase == Chip8EmulatorOptions::eMEGACHIP ? 256 : options.optAllowHires ? 128 : 64; }
+    static int maxScreenHeight(const Chip8EmulatorOptions& options) { return options.behaviorBase == Chip8EmulatorOptions::eMEGACHIP ? 192 : options.optAllowHires ? 64 : 32; }
+    void enterMegaChipMode()
+    {
+        // the RGBA screens are only needed by MegaChip mode, so they are allocated on first use
+        if(!_screenRGBA1.isAllocated()) {
+            _screenRGBA1.setBufferSize(MAX_SCREEN_WIDTH, MAX_SCREEN_HEIGHT);
+            _screenRGBA2.setBufferSize(MAX_SCREEN_WIDTH, MAX_SCREEN_HEIGHT);
+        }
+        _isMegaChipMode = true;
+    }
     void swapMegaSchreens() {
         std::swap(_screenRGBA, _workRGBA);
     }
@@ -309,16 +324,17 @@ protected:
     int _frameCounter{0};
     int _clearCounter{0};
     ClockedTime _systemTime;
+    double _instructionsPerMicro{1.0};  // calibrated rate of the unlimited speed mode
     uint32_t _rI{};
     uint32_t _rPC{};
     std::array<uint16_t,16> _stack{};
     uint8_t _rSP{};
     uint8_t _rDT{};
     std::atomic<uint8_t> _rST{};
-    float _wavePhase{0};
-    VideoScreen<uint8_t, MAX_SCREEN_WIDTH, MAX_SCREEN_HEIGHT> _screen;
-    VideoScreen<uint32_t, MAX_SCREEN_WIDTH, MAX_SCREEN_HEIGHT> _screenRGBA1{};
-    VideoScreen<uint32_t, MAX_SCREEN_WIDTH, MAX_SCREEN_HEIGHT> _screenRGBA2{};
+    uint32_t _wavePhase{0};
+    VideoScreen<uint8_t, MAX_SCREEN_WIDTH, MAX_SCREEN_HEIGHT> _screen{0, 0};
+    VideoScreen<uint32_t, MAX_SCREEN_WIDTH, MAX_SCREEN_HEIGHT> _screenRGBA1{0, 0};
+    VideoScreen<uint32_t, MAX_SCREEN_WIDTH, MAX_SCREEN_HEIGHT> _screenRGBA2{0, 0};
     VideoScreen<uint32_t, MAX_SCREEN_WIDTH, MAX_SCREEN_HEIGHT>* _screenRGBA{};
     VideoScreen<uint32_t, MAX_SCREEN_WIDTH, MAX_SCREEN_HEIGHT>* _workRGBA{};
     std::array<uint8_t,16> _xoAudioPattern{};
@@ -28,6 +28,7 @@
 #include <chiplet/chip8meta.hpp>
 #include <emulation/chip8options.hpp>
 #include <emulation/chip8emulatorbase.hpp>
+#include <emulation/oscillator.hpp>
 #include <emulation/time.hpp>
 #include <iostream>
 
@@ -53,6 +54,7 @@ public:
     {
         _systemTime.setFrequency(CPU_CLOCK_FREQUENCY>>3);
         _memory.resize(MEMORY_SIZE, 0);
+        _screen.setMode(SCREEN_WIDTH, SCREEN_HEIGHT);
     }
     ~Chip8StrictEmulator() override = default;
 
@@ -469,11 +471,7 @@ public:
     void renderAudio(int16_t* samples, size_t frames, int sampleFrequency) override
     {
         if(_rST) {
-            const float step = 1000.0f / 44100;
-            for (int i = 0; i < frames; ++i) {
-                *samples++ = (_wavePhase > 0.5f) ? 16384 : -16384;
-                _wavePhase = std::fmod(_wavePhase + step, 1.0f);
-            }
+            oscillator::renderSquare(samples, frames, _wavePhase, oscillator::phaseStep(1000.0, sampleFrequency));
         }
         else {
             // Default is silence
@@ -1,6 +1,7 @@
 #include <emulation/chip8vip.hpp>
 #include <emulation/logger.hpp>
 #include <emulation/hardware/cdp186x.hpp>
+#include <emulation/oscillator.hpp>
 #include <chiplet/utility.hpp>
 
 #include <fmt/format.h>
@@ -108,7 +109,7 @@ public:
     uint16_t _colorRamMask{0xff};
     uint16_t _colorRamMaskLores{0xe7};
     bool _mapRam{false};
-    float _wavePhase{0};
+    uint32_t _wavePhase{0};
     std::vector<uint8_t> _ram{};
     std::array<uint8_t,1024> _colorRam{};
     std::array<uint8_t,512> _rom{};
@@ -825,11 +826,7 @@ void Chip8VIP::renderAudio(int16_t* samples, size_t frames, int sampleFrequency)
 {
     if(_impl->_cpu.getQ()) {
         auto audioFrequency = _impl->_video.getType() == Cdp186x::eVP590 ? 27535.0f / ((unsigned)_impl->_frequencyLatch + 1) : 1400.0f;
-        const float step = audioFrequency / sampleFrequency;
-        for (int i = 0; i < frames; ++i) {
-            *samples++ = (_impl->_wavePhase > 0.5f) ? 16384 : -16384;
-            _impl->_wavePhase = std::fmod(_impl->_wavePhase + step, 1.0f);
-        }
+        oscillator::renderSquare(samples, frames, _impl->_wavePhase, oscillator::phaseStep(audioFrequency, sampleFrequency));
     }
     else {
         // Default is silence
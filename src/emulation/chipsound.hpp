@@ -25,19 +25,32 @@
 //---------------------------------------------------------------------------------------
 #pragma once
 
+#include <emulation/simd.hpp>
+
 #include <algorithm>
+#include <climits>
 #include <cmath>
+#include <cstddef>
 #include <cstdint>
 
 namespace emu {
 
+//---------------------------------------------------------------------------------------
+// Four voice synthesizer with ADSR envelopes and a state variable filter per voice.
+// The voice state is kept as structure of arrays with one lane per voice, so all four
+// voices are rendered together, with SSE2 where available. Envelopes are linear ramps,
+// a block is split where a segment of any voice ends, so the inner loop only adds the
+// per sample delta. Filter and waveform coefficients are set up once per block.
+//---------------------------------------------------------------------------------------
 class ChipSound
 {
 public:
     constexpr static const float fPi = 3.1415926535f;
+    constexpr static int NUM_VOICES = 4;
 
     enum Waveform { eNONE, eSINE, ePULSE, eSAW, eNOISE, eAAPULSE, eAASQUARE, eAASAW };
     enum EnvelopeState { eIDLE, eATTACK, eDECAY, eSUSTAIN, eRELEASE };
+    enum FilterMode { eLOWPASS = 1, eBANDPASS = 2, eHIGHPASS = 4 };
 
     struct VoiceInfo
     {
@@ -52,38 +65,27 @@ public:
         uint8_t cutoff;         // 5
         uint8_t filter : 4;     // 6
         uint8_t resonance : 4;  //
-        //----
-        float _frequency{0};
-        float _sampleLength{0};
-        float _phase{0};
-        int _noiseAcc{0};
-        //----
-        int _envState{eIDLE};
-        int _envAttackSteps;
-        int _envDecaySteps;
-        int _envReleaseSteps;
-        float _envAttackDelta;
-        float _envDecayDelta;
-        float _envReleaseDelta;
-        float _envStepTime;
-        int _envStep{0};
-        bool _noteOnEvent{false};
-        bool _noteOffEvent{false};
     };
 
-    ChipSound()
+    explicit ChipSound(int sampleFrequency = 44100)
+        : _sampleFrequency(sampleFrequency)
     {
-        int noise = 0x7ffff8L;
-        for (int i = 0; i < 0x10000; ++i) {
-            noise = (noise * 196314165) + 907633515;
-            _noiseBuffer[i] = (short)noise;
+        for (int i = 0; i < NUM_VOICES; ++i) {
+            _noise[i] = 0x7ffff8u + i * 0x9E3779B9u;
+            _envRemaining[i] = INT_MAX;
         }
     }
 
-    inline float envelopeTime(uint8_t ti) { return std::clamp(std::pow(2.0f, float(ti) / 1.5f - 6.0f) / 2, 0.002f, 8.0f); }
+    const VoiceInfo& voice(uint8_t voiceId) const { return _voice[voiceId & 3]; }
+
+    inline float envelopeTime(uint8_t ti) const { return std::clamp(std::pow(2.0f, float(ti) / 1.5f - 6.0f) / 2, 0.002f, 8.0f); }
+
+    // Sets the seven parameter bytes of a voice and triggers a note on, the tone is a
+    // note number with 69 being A4 at 440Hz
     void updateParameters(uint8_t voiceId, const uint8_t* data)
     {
-        VoiceInfo& vi = _voice[voiceId & 3];
+        const int v = voiceId & 3;
+        VoiceInfo& vi = _voice[v];
         vi.tone = *data++;
         vi.pulsewidth = *data++;
         vi.waveform = *data >> 5;
@@ -96,144 +98,298 @@ public:
         vi.filter = *data >> 4;
         vi.resonance = *data++ & 0xF;
 
-        // init oscillator
-        vi._frequency = 440;
-        vi._phase = 0;
-        vi._sampleLength = vi._frequency * _stepTime;
+        // oscillator, one period is 2^32
+        auto frequency = 440.0 * std::pow(2.0, (int(vi.tone) - 69) / 12.0);
+        _phaseStep[v] = uint32_t(std::min(frequency / _sampleFrequency, 0.5) * 4294967296.0);
+        _noiseStep[v] = std::min(_phaseStep[v], uint32_t(0x0FFFFFFF)) << 4;
+        _pulseWidth[v] = (vi.waveform == eAASQUARE ? 128 : vi.pulsewidth) / 256.0f;
+
+        // envelope
+        _attackSamples[v] = std::max(1, int(envelopeTime(vi.attack) * _sampleFrequency));
+        _decaySamples[v] = std::max(1, int(envelopeTime(vi.decay) * 3 * _sampleFrequency));
+        _releaseSamples[v] = std::max(1, int(envelopeTime(vi.release) * 3 * _sampleFrequency));
+        _sustainLevel[v] = float(vi.sustain) / 15.0f;
+        _noteOnEvent[v] = true;
+        _noteOffEvent[v] = false;
+        _coefficientsDirty = true;
+    }
+
+    void noteOff(uint8_t voiceId)
+    {
+        _noteOffEvent[voiceId & 3] = true;
+    }
+
+    // Renders with the portable code even where SSE2 is available, used to compare both
+    void setScalar(bool scalar) { _scalar = scalar; }
+
+    EnvelopeState envelopeState(uint8_t voiceId) const { return EnvelopeState(_envState[voiceId & 3]); }
+    float envelopeLevel(uint8_t voiceId) const { return _envLevel[voiceId & 3]; }
+
+    // Renders a block of mono samples
+    void render(int16_t* samples, size_t frames)
+    {
+        if (_coefficientsDirty) {
+            updateCoefficients();
+        }
+        while (frames) {
+            for (int v = 0; v < NUM_VOICES; ++v) {
+                handleEnvelopeEvents(v);
+            }
+            size_t chunk = frames;
+            for (int v = 0; v < NUM_VOICES; ++v) {
+                chunk = std::min(chunk, size_t(_envRemaining[v]));
+            }
+            renderChunk(samples, chunk);
+            for (int v = 0; v < NUM_VOICES; ++v) {
+                if (_envRemaining[v] != INT_MAX && (_envRemaining[v] -= int(chunk)) == 0) {
+                    nextEnvelopeSegment(v);
+                }
+            }
+            samples += chunk;
+            frames -= chunk;
+        }
+    }
 
-        // init adsr
-        float temp = envelopeTime(vi.attack) / _stepTime;
-        vi._envAttackSteps = (int)temp;
-        vi._envAttackDelta = (float)(1.0f / temp);
+    void nextSample()
+    {
+        render(&_sample, 1);
+    }
 
-        temp = envelopeTime(vi.decay) * 3 / _stepTime;
-        vi._envDecaySteps = (int)temp;
-        vi._envDecayDelta = (1.0f - vi.sustain) / temp;
+    int16_t sample() const { return _sample; }
 
-        temp = envelopeTime(vi.release) * 3 / _stepTime;
-        vi._envReleaseSteps = (int)temp;
-        vi._envReleaseDelta = vi.sustain / temp;
-        vi._noteOnEvent = true;
+private:
+    void startSegment(int v, EnvelopeState state, float target, int samples)
+    {
+        _envState[v] = state;
+        if (samples == INT_MAX) {
+            _envLevel[v] = target;
+            _envDelta[v] = 0.0f;
+        }
+        else {
+            _envDelta[v] = (target - _envLevel[v]) / float(samples);
+        }
+        _envTarget[v] = target;
+        _envRemaining[v] = samples;
     }
 
-    float envelopeStep(VoiceInfo& vi)
+    void handleEnvelopeEvents(int v)
     {
-        float value = 0.0f;
-        switch (vi._envState) {
-            case eIDLE:
-                vi._noteOffEvent = false;
-                if (vi._noteOnEvent)
-                    vi._noteOnEvent = false, vi._envStep = 0, vi._envState = eATTACK;
-                break;
+        if (_noteOnEvent[v]) {
+            // a retrigger ramps up from the current level instead of clicking to zero
+            _noteOnEvent[v] = false;
+            startSegment(v, eATTACK, 1.0f, std::max(1, int(_attackSamples[v] * (1.0f - _envLevel[v]))));
+        }
+        if (_noteOffEvent[v]) {
+            _noteOffEvent[v] = false;
+            if (_envState[v] != eIDLE && _envState[v] != eRELEASE) {
+                startSegment(v, eRELEASE, 0.0f, std::max(1, int(_releaseSamples[v] * _envLevel[v])));
+            }
+        }
+    }
+
+    void nextEnvelopeSegment(int v)
+    {
+        // snap to the target, so rounding of the ramps does not accumulate
+        _envLevel[v] = _envTarget[v];
+        switch (_envState[v]) {
             case eATTACK:
-                value = vi._envStep * vi._envAttackDelta;
-                if (vi._noteOnEvent)
-                    value /= 2.0f, vi._envState = eIDLE;
-                else if (vi._envStep >= vi._envAttackSteps)
-                    vi._envStep = 0, vi._envState = eDECAY;
-                else
-                    ++vi._envStep;
+                startSegment(v, eDECAY, _sustainLevel[v], _decaySamples[v]);
                 break;
             case eDECAY:
-                value = 1.0f - (vi._envStep * vi._envDecayDelta);
-                if (vi._noteOnEvent)
-                    vi._envState = eIDLE, value /= 2.0f;
-                else if (vi._envStep >= vi._envDecaySteps)
-                    vi._envState = eSUSTAIN;
-                else
-                    ++vi._envStep;
+                startSegment(v, eSUSTAIN, _sustainLevel[v], INT_MAX);
                 break;
-            case eSUSTAIN:
-                value = float(vi.sustain) / 15.0f;
-                if (vi._noteOnEvent)
-                    vi._envState = eIDLE, value /= 2.0f;
-                else if (vi._noteOffEvent)
-                    vi._noteOffEvent = false, vi._envStep = 0, vi._envState = eRELEASE;
-                break;
-            case eRELEASE:
-                value = float(vi.sustain) / 15.0f - (vi._envStep * vi._envReleaseDelta);
-                if (vi._noteOnEvent)
-                    vi._envState = eIDLE, value /= 2.0f;
-                else if (value < 0)
-                    value = 0;
-                if (vi._envStep >= vi._envReleaseSteps)
-                    vi._envState = eIDLE;
-                else
-                    ++vi._envStep;
+            default:
+                startSegment(v, eIDLE, 0.0f, INT_MAX);
                 break;
         }
-        return value;
     }
 
-    void nextSample()
+    // Chamberlin state variable filter, the cutoff byte spans about 30Hz to the stability
+    // limit of the filter at a sixth of the sample rate
+    void updateCoefficients()
     {
-        float sample = 0;
+        for (int v = 0; v < NUM_VOICES; ++v) {
+            const auto& vi = _voice[v];
+            auto waveform = vi.waveform == eAAPULSE || vi.waveform == eAASQUARE ? ePULSE : vi.waveform == eAASAW ? eSAW : Waveform(vi.waveform);
+            _waveSine[v] = waveform == eSINE ? 1.0f : 0.0f;
+            _wavePulse[v] = waveform == ePULSE ? 1.0f : 0.0f;
+            _waveSaw[v] = waveform == eSAW ? 1.0f : 0.0f;
+            _waveNoise[v] = waveform == eNOISE ? 1.0f : 0.0f;
+            auto cutoff = std::min(30.0f * std::pow(2.0f, vi.cutoff / 25.6f), _sampleFrequency / 6.0f);
+            _filterF[v] = 2.0f * std::sin(fPi * cutoff / _sampleFrequency);
+            _filterQ[v] = 2.0f - vi.resonance * (1.9f / 15.0f);
+            _mixDry[v] = vi.filter & 7 ? 0.0f : 1.0f;
+            _mixLow[v] = vi.filter & eLOWPASS ? 1.0f : 0.0f;
+            _mixBand[v] = vi.filter & eBANDPASS ? 1.0f : 0.0f;
+            _mixHigh[v] = vi.filter & eHIGHPASS ? 1.0f : 0.0f;
+        }
+        _coefficientsDirty = false;
+    }
 
-        for (int i = 0; i < 4; ++i) {
-            if (_voice[i]._frequency > 0.1f) {
-                _voice[i]._noiseAcc = (_voice[i]._noiseAcc + (int)(_voice[i]._frequency)) & 0xfffffff;
-                float val = waveformFunction(_voice[i]) * envelopeStep(_voice[i]);
+    void renderChunk(int16_t* samples, size_t frames)
+    {
+#ifdef CADMIUM_WITH_SSE2
+        if (!_scalar) {
+            renderChunkSSE2(samples, frames);
+            return;
+        }
+#endif
+        renderChunkScalar(samples, frames);
+    }
 
-                _voice[i]._phase += _voice[i]._sampleLength;
-                if (_voice[i]._phase >= 1.0f) {
-                    _voice[i]._phase -= 1.0f;
+#ifdef CADMIUM_WITH_SSE2
+    void renderChunkSSE2(int16_t* samples, size_t frames)
+    {
+        const __m128i signBit = _mm_set1_epi32(int(0x80000000u));
+        const __m128 phaseScale = _mm_set1_ps(1.0f / 16777216.0f);
+        const __m128 noiseScale = _mm_set1_ps(1.0f / 2147483648.0f);
+        const __m128 one = _mm_set1_ps(1.0f), minusOne = _mm_set1_ps(-1.0f), half = _mm_set1_ps(0.5f), two = _mm_set1_ps(2.0f);
+        const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+        const __m128i phaseStep = _mm_load_si128((const __m128i*)_phaseStep), noiseStep = _mm_load_si128((const __m128i*)_noiseStep);
+        const __m128 pulseWidth = _mm_load_ps(_pulseWidth), envDelta = _mm_load_ps(_envDelta);
+        const __m128 waveSine = _mm_load_ps(_waveSine), wavePulse = _mm_load_ps(_wavePulse), waveSaw = _mm_load_ps(_waveSaw), waveNoise = _mm_load_ps(_waveNoise);
+        const __m128 filterF = _mm_load_ps(_filterF), filterQ = _mm_load_ps(_filterQ);
+        const __m128 mixDry = _mm_load_ps(_mixDry), mixLow = _mm_load_ps(_mixLow), mixBand = _mm_load_ps(_mixBand), mixHigh = _mm_load_ps(_mixHigh);
+        __m128i phase = _mm_load_si128((const __m128i*)_phase), noisePhase = _mm_load_si128((const __m128i*)_noisePhase), noise = _mm_load_si128((const __m128i*)_noise);
+        __m128 envLevel = _mm_load_ps(_envLevel), low = _mm_load_ps(_filterLow), band = _mm_load_ps(_filterBand);
+        for (size_t i = 0; i < frames; i += 4) {
+            // the filtered voice outputs of up to four samples, one vector per sample
+            const size_t count = std::min(frames - i, size_t(4));
+            alignas(16) float lanes[16];
+            for (size_t k = 0; k < count; ++k) {
+                auto p = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(phase, 8)), phaseScale);
+                // sin(2*pi*p) = -sin(pi*t) with t in [-1,1), parabola with one refinement step
+                auto t = _mm_sub_ps(_mm_add_ps(p, p), one);
+                auto y = _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(4.0f), t), _mm_sub_ps(one, _mm_and_ps(t, absMask)));
+                y = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(0.225f), _mm_sub_ps(_mm_mul_ps(y, _mm_and_ps(y, absMask)), y)), y);
+                auto pulse = _mm_or_ps(_mm_and_ps(_mm_cmple_ps(p, pulseWidth), one), _mm_andnot_ps(_mm_cmple_ps(p, pulseWidth), minusOne));
+                auto saw = _mm_sub_ps(_mm_add_ps(p, p), _mm_and_ps(_mm_cmpge_ps(p, half), two));
+                auto noiseValue = _mm_mul_ps(_mm_cvtepi32_ps(noise), noiseScale);
+                auto value = _mm_mul_ps(waveSine, _mm_sub_ps(_mm_setzero_ps(), y));
+                value = _mm_add_ps(value, _mm_mul_ps(wavePulse, pulse));
+                value = _mm_add_ps(value, _mm_mul_ps(waveSaw, saw));
+                value = _mm_add_ps(value, _mm_mul_ps(waveNoise, noiseValue));
+                value = _mm_mul_ps(value, envLevel);
+                // filter
+                low = _mm_add_ps(low, _mm_mul_ps(filterF, band));
+                auto high = _mm_sub_ps(_mm_sub_ps(value, low), _mm_mul_ps(filterQ, band));
+                band = _mm_add_ps(band, _mm_mul_ps(filterF, high));
+                auto result = _mm_add_ps(_mm_add_ps(_mm_mul_ps(mixDry, value), _mm_mul_ps(mixLow, low)), _mm_add_ps(_mm_mul_ps(mixBand, band), _mm_mul_ps(mixHigh, high)));
+                // advance oscillators, the noise lanes clock their xorshift on a wrap of the noise phase
+                phase = _mm_add_epi32(phase, phaseStep);
+                auto nextNoisePhase = _mm_add_epi32(noisePhase, noiseStep);
+                auto wrapped = _mm_cmpgt_epi32(_mm_xor_si128(noisePhase, signBit), _mm_xor_si128(nextNoisePhase, signBit));
+                noisePhase = nextNoisePhase;
+                auto x = _mm_xor_si128(noise, _mm_slli_epi32(noise, 13));
+                x = _mm_xor_si128(x, _mm_srli_epi32(x, 17));
+                x = _mm_xor_si128(x, _mm_slli_epi32(x, 5));
+                noise = simd::select(wrapped, x, noise);
+                envLevel = _mm_add_ps(envLevel, envDelta);
+                _mm_store_ps(lanes + k * 4, result);
+            }
+            if (count == 4) {
+                // transposed there is one vector per voice and the sums are four samples
+                auto s0 = _mm_load_ps(lanes), s1 = _mm_load_ps(lanes + 4), s2 = _mm_load_ps(lanes + 8), s3 = _mm_load_ps(lanes + 12);
+                _MM_TRANSPOSE4_PS(s0, s1, s2, s3);
+                auto sum = _mm_add_ps(_mm_add_ps(s0, s2), _mm_add_ps(s1, s3));
+                sum = _mm_mul_ps(_mm_min_ps(_mm_max_ps(_mm_mul_ps(sum, half), minusOne), one), _mm_set1_ps(32767.0f));
+                auto packed = _mm_cvttps_epi32(sum);
+                _mm_storel_epi64((__m128i*)(samples + i), _mm_packs_epi32(packed, packed));
+            }
+            else {
+                for (size_t k = 0; k < count; ++k) {
+                    const float* l = lanes + k * 4;
+                    samples[i + k] = toSample((l[0] + l[2]) + (l[1] + l[3]));
                 }
-
-                sample += val / 2.0f;
             }
         }
-        _sample = int16_t(std::clamp(sample, -1.0f, 1.0f) * 32767.0f);
+        _mm_store_si128((__m128i*)_phase, phase);
+        _mm_store_si128((__m128i*)_noisePhase, noisePhase);
+        _mm_store_si128((__m128i*)_noise, noise);
+        _mm_store_ps(_envLevel, envLevel);
+        _mm_store_ps(_filterLow, low);
+        _mm_store_ps(_filterBand, band);
     }
+#endif
 
-    int16_t sample() const;
-
-    float waveformFunction(VoiceInfo& vi)
+    void renderChunkScalar(int16_t* samples, size_t frames)
     {
-        switch (vi.waveform) {
-            case eNONE:
-                return 0;
-            case eSINE:
-                return std::sin(2.0f * fPi * vi._phase);
-            case ePULSE:
-                return vi._phase <= (float(vi.pulsewidth) / 256) ? 1.0f : -1.0f;
-            case eSAW:
-                return 2.0f * (vi._phase - std::floor(vi._phase + 0.5f));
-            case eNOISE:
-                return (float)_noiseBuffer[(vi._noiseAcc >> 12) & 0xffff] / 32768.0f;
-#ifdef WITH_WAVETABLES
-            case eAAPULSE: {
-                if (std::fabs(_params->pulseWidth - 0.5f) < 0.001) {
-                    val = _waveTables[eAASQUARE]->valueForPhase(_frequency, _phase);
+        for (size_t i = 0; i < frames; ++i) {
+            float lanes[NUM_VOICES];
+            for (int v = 0; v < NUM_VOICES; ++v) {
+                auto p = float(_phase[v] >> 8) * (1.0f / 16777216.0f);
+                auto t = p + p - 1.0f;
+                auto y = 4.0f * t * (1.0f - std::fabs(t));
+                y = 0.225f * (y * std::fabs(y) - y) + y;
+                auto pulse = p <= _pulseWidth[v] ? 1.0f : -1.0f;
+                auto saw = p + p - (p >= 0.5f ? 2.0f : 0.0f);
+                auto noiseValue = float(int32_t(_noise[v])) * (1.0f / 2147483648.0f);
+                auto value = _waveSine[v] * -y;
+                value += _wavePulse[v] * pulse;
+                value += _waveSaw[v] * saw;
+                value += _waveNoise[v] * noiseValue;
+                value *= _envLevel[v];
+                _filterLow[v] += _filterF[v] * _filterBand[v];
+                auto high = value - _filterLow[v] - _filterQ[v] * _filterBand[v];
+                _filterBand[v] += _filterF[v] * high;
+                lanes[v] = (_mixDry[v] * value + _mixLow[v] * _filterLow[v]) + (_mixBand[v] * _filterBand[v] + _mixHigh[v] * high);
+                _phase[v] += _phaseStep[v];
+                auto nextNoisePhase = _noisePhase[v] + _noiseStep[v];
+                if (nextNoisePhase < _noisePhase[v]) {
+                    auto x = _noise[v] ^ (_noise[v] << 13);
+                    x ^= x >> 17;
+                    _noise[v] = x ^ (x << 5);
                 }
-                else {
-                    // TODO: This still creates DC offsets
-                    float offset = _phase + _params->pulseWidth;
-                    if (offset >= 1.0) {
-                        offset -= 1.0;
-                    }
-                    val = _waveTables[eAASAW]->valueForPhase(_frequency, _phase) - _waveTables[eAASAW]->valueForPhase(_frequency, offset);
-                }
-                break;
+                _noisePhase[v] = nextNoisePhase;
+                _envLevel[v] += _envDelta[v];
             }
-            case eAASQUARE:
-                val = _waveTables[eWTSQUARE]->valueForPhase(_frequency, _phase);
-                break;
-            case eAASAW:
-                val = _waveTables[eWTSAW]->valueForPhase(_frequency, _phase);
-                break;
-            case eAATRIANGLE:
-                val = _waveTables[eWTTRIANGLE]->valueForPhase(_frequency, _phase);
-                break;
-#endif
-            default:
-                return 0.0f;
+            // same summation order as the SSE2 path
+            samples[i] = toSample((lanes[0] + lanes[2]) + (lanes[1] + lanes[3]));
         }
     }
 
-    const float _stepTime = 1.0f / 44100;
-    VoiceInfo _voice[4];
-    int16_t _sample;
-    inline static short _noiseBuffer[0x10000];
+    static int16_t toSample(float sum)
+    {
+        return int16_t(std::clamp(sum / 2.0f, -1.0f, 1.0f) * 32767.0f);
+    }
+
+    int _sampleFrequency;
+    VoiceInfo _voice[NUM_VOICES]{};
+    bool _coefficientsDirty{true};
+    bool _scalar{false};
+    int16_t _sample{0};
+    // oscillators
+    alignas(16) uint32_t _phase[NUM_VOICES]{};
+    alignas(16) uint32_t _phaseStep[NUM_VOICES]{};
+    alignas(16) uint32_t _noisePhase[NUM_VOICES]{};
+    alignas(16) uint32_t _noiseStep[NUM_VOICES]{};
+    alignas(16) uint32_t _noise[NUM_VOICES]{};
+    alignas(16) float _pulseWidth[NUM_VOICES]{};
+    alignas(16) float _waveSine[NUM_VOICES]{};
+    alignas(16) float _wavePulse[NUM_VOICES]{};
+    alignas(16) float _waveSaw[NUM_VOICES]{};
+    alignas(16) float _waveNoise[NUM_VOICES]{};
+    // envelopes
+    alignas(16) float _envLevel[NUM_VOICES]{};
+    alignas(16) float _envDelta[NUM_VOICES]{};
+    float _envTarget[NUM_VOICES]{};
+    int _envState[NUM_VOICES]{};
+    int _envRemaining[NUM_VOICES]{};
+    int _attackSamples[NUM_VOICES]{};
+    int _decaySamples[NUM_VOICES]{};
+    int _releaseSamples[NUM_VOICES]{};
+    float _sustainLevel[NUM_VOICES]{};
+    bool _noteOnEvent[NUM_VOICES]{};
+    bool _noteOffEvent[NUM_VOICES]{};
+    // filters
+    alignas(16) float _filterF[NUM_VOICES]{};
+    alignas(16) float _filterQ[NUM_VOICES]{};
+    alignas(16) float _filterLow[NUM_VOICES]{};
+    alignas(16) float _filterBand[NUM_VOICES]{};
+    alignas(16) float _mixDry[NUM_VOICES]{};
+    alignas(16) float _mixLow[NUM_VOICES]{};
+    alignas(16) float _mixBand[NUM_VOICES]{};
+    alignas(16) float _mixHigh[NUM_VOICES]{};
 };
 
-}  // namespace emu
\ No newline at end of file
+}  // namespace emu
@@ -0,0 +1,261 @@
+//---------------------------------------------------------------------------------------
+// src/emulation/crtfilter.cpp
+//---------------------------------------------------------------------------------------
+//
+// Copyright (c) 2015, Steffen Schümann <s.schuemann@pobox.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//---------------------------------------------------------------------------------------
+
+#include <emulation/crtfilter.hpp>
+#include <emulation/simd.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace emu {
+
+static constexpr int BAND_ROWS = 8;
+
+static inline uint64_t packWork(uint32_t generation, int numBands, int nextBand)
+{
+    return (uint64_t(generation) << 32) | (uint64_t(numBands) << 16) | uint64_t(nextBand);
+}
+
+// Per byte average rounding up, same as _mm_avg_epu8
+static inline uint32_t average(uint32_t a, uint32_t b)
+{
+    return (a | b) - (((a ^ b) >> 1) & 0x7F7F7F7F);
+}
+
+static inline void replicate(uint32_t* dst, uint32_t pixel, int count)
+{
+#ifdef CADMIUM_WITH_SSE2
+    const auto val = _mm_set1_epi32(int(pixel));
+    for (; count >= 4; count -= 4, dst += 4)
+        _mm_storeu_si128((__m128i*)dst, val);
+#endif
+    while (count--)
+        *dst++ = pixel;
+}
+
+// Horizontal 1-2-1 blur of a source row, padded is scratch space for width + 2 pixels
+static void blurRow(const uint32_t* src, int width, uint32_t* padded, uint32_t* dst)
+{
+    padded[0] = src[0];
+    std::memcpy(padded + 1, src, width * sizeof(uint32_t));
+    padded[width + 1] = src[width - 1];
+    int x = 0;
+#ifdef CADMIUM_WITH_SSE2
+    for (; x + 4 <= width; x += 4) {
+        auto left = _mm_loadu_si128((const __m128i*)(padded + x));
+        auto center = _mm_loadu_si128((const __m128i*)(padded + x + 1));
+        auto right = _mm_loadu_si128((const __m128i*)(padded + x + 2));
+        _mm_storeu_si128((__m128i*)(dst + x), _mm_avg_epu8(center, _mm_avg_epu8(left, right)));
+    }
+#endif
+    for (; x < width; ++x)
+        dst[x] = average(padded[x + 1], average(padded[x], padded[x + 2]));
+}
+
+// Vertical 1-2-1 blur of three horizontally blurred rows
+static void blurColumns(const uint32_t* above, const uint32_t* center, const uint32_t* below, int width, uint32_t* dst)
+{
+    int x = 0;
+#ifdef CADMIUM_WITH_SSE2
+    for (; x + 4 <= width; x += 4) {
+        auto a = _mm_loadu_si128((const __m128i*)(above + x));
+        auto c = _mm_loadu_si128((const __m128i*)(center + x));
+        auto b = _mm_loadu_si128((const __m128i*)(below + x));
+        _mm_storeu_si128((__m128i*)(dst + x), _mm_avg_epu8(c, _mm_avg_epu8(a, b)));
+    }
+#endif
+    for (; x < width; ++x)
+        dst[x] = average(center[x], average(above[x], below[x]));
+}
+
+// One output row: source * weight + bloom * bloomLevel, saturated and scaled horizontally
+static void emitRow(const uint32_t* src, const uint32_t* bloom, int width, uint16_t weight, uint16_t bloomLevel, uint32_t* dst, int scale)
+{
+    int x = 0;
+#ifdef CADMIUM_WITH_SSE2
+    const auto zero = _mm_setzero_si128();
+    const auto alpha = _mm_set1_epi32(int(0xFF000000));
+    const auto w16 = _mm_set1_epi16(short(weight));
+    const auto b16 = _mm_set1_epi16(short(bloomLevel));
+    for (; x + 4 <= width; x += 4) {
+        auto s = _mm_loadu_si128((const __m128i*)(src + x));
+        auto b = _mm_loadu_si128((const __m128i*)(bloom + x));
+        auto lo = _mm_adds_epu16(_mm_srli_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(s, zero), w16), 8), _mm_srli_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(b, zero), b16), 8));
+        auto hi = _mm_adds_epu16(_mm_srli_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(s, zero), w16), 8), _mm_srli_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(b, zero), b16), 8));
+        auto pixels = _mm_or_si128(_mm_packus_epi16(lo, hi), alpha);
+        auto* out = dst + x * scale;
+        if (scale == 4) {
+            _mm_storeu_si128((__m128i*)out, _mm_shuffle_epi32(pixels, 0x00));
+            _mm_storeu_si128((__m128i*)(out + 4), _mm_shuffle_epi32(pixels, 0x55));
+            _mm_storeu_si128((__m128i*)(out + 8), _mm_shuffle_epi32(pixels, 0xAA));
+            _mm_storeu_si128((__m128i*)(out + 12), _mm_shuffle_epi32(pixels, 0xFF));
+        }
+        else {
+            alignas(16) uint32_t result[4];
+            _mm_store_si128((__m128i*)result, pixels);
+            for (int i = 0; i < 4; ++i)
+                replicate(out + i * scale, result[i], scale);
+        }
+    }
+#endif
+    for (; x < width; ++x) {
+        uint32_t pixel = 0xFF000000;
+        for (int shift = 0; shift < 24; shift += 8) {
+            auto c = ((src[x] >> shift) & 0xFF) * weight >> 8;
+            auto b = ((bloom[x] >> shift) & 0xFF) * bloomLevel >> 8;
+            pixel |= std::min(c + b, 255u) << shift;
+        }
+        replicate(dst + x * scale, pixel, scale);
+    }
+}
+
+CrtFilter::CrtFilter(int numThreads)
+{
+    if (numThreads <= 0) {
+#ifdef __EMSCRIPTEN__
+        numThreads = 1;
+#else
+        numThreads = std::clamp(int(std::thread::hardware_concurrency()), 1, 8);
+#endif
+    }
+    setSettings(_settings);
+    for (int i = 1; i < numThreads; ++i) {
+        _workers.emplace_back(&CrtFilter::worker, this);
+    }
+}
+
+CrtFilter::~CrtFilter()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _shutdown = true;
+    }
+    _startCondition.notify_all();
+    for (auto& worker : _workers) {
+        worker.join();
+    }
+}
+
+void CrtFilter::setSettings(const Settings& settings)
+{
+    _settings = settings;
+    _settings.scale = std::clamp(_settings.scale, 1, 16);
+    // every scanline gets a quadratic brightness falloff from its center, a weight of 256 is unchanged
+    _rowWeights.resize(_settings.scale);
+    for (int row = 0; row < _settings.scale; ++row) {
+        auto distance = ((row + 0.5) / _settings.scale - 0.5) * 2;
+        _rowWeights[row] = uint16_t(256 - std::lround((255 - _settings.scanlineLevel) * 256.0 / 255.0 * distance * distance));
+    }
+}
+
+void CrtFilter::process(const uint32_t* source, int width, int height, int sourceStride, uint32_t* destination, int destinationStride)
+{
+    if (width <= 0 || height <= 0)
+        return;
+    const int numBands = (height + BAND_ROWS - 1) / BAND_ROWS;
+    uint32_t generation;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _source = source;
+        _destination = destination;
+        _width = width;
+        _height = height;
+        _sourceStride = sourceStride;
+        _destinationStride = destinationStride;
+        _bandsDone = 0;
+        generation = uint32_t(++_generation);
+        _work.store(packWork(generation, numBands, 0), std::memory_order_release);
+    }
+    _startCondition.notify_all();
+    processBands(generation, _scratch);
+    std::unique_lock<std::mutex> lock(_mutex);
+    _doneCondition.wait(lock, [&]() { return _bandsDone == numBands; });
+}
+
+void CrtFilter::worker()
+{
+    std::vector<uint32_t> scratch;
+    uint64_t generation = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _startCondition.wait(lock, [&]() { return _shutdown || _generation != generation; });
+            if (_shutdown)
+                return;
+            generation = _generation;
+        }
+        processBands(uint32_t(generation), scratch);
+    }
+}
+
+// Bands are claimed by a compare-exchange on the packed work word, so a claim only succeeds
+// while the word still belongs to the given generation, stale workers just drop out
+void CrtFilter::processBands(uint32_t generation, std::vector<uint32_t>& scratch)
+{
+    auto work = _work.load(std::memory_order_acquire);
+    while (true) {
+        const auto numBands = int((work >> 16) & 0xFFFF);
+        const auto band = int(work & 0xFFFF);
+        if (uint32_t(work >> 32) != generation || band >= numBands)
+            return;
+        if (!_work.compare_exchange_weak(work, work + 1, std::memory_order_acq_rel, std::memory_order_acquire))
+            continue;
+        processBand(band, scratch);
+        if (++_bandsDone == numBands) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _doneCondition.notify_one();
+        }
+        work = _work.load(std::memory_order_acquire);
+    }
+}
+
+void CrtFilter::processBand(int band, std::vector<uint32_t>& scratch)
+{
+    const auto width = _width;
+    const auto scale = _settings.scale;
+    if (scratch.size() < size_t(width) * 5 + 2)
+        scratch.resize(size_t(width) * 5 + 2);
+    auto* padded = scratch.data();
+    uint32_t* blurred[3] = {padded + width + 2, padded + width * 2 + 2, padded + width * 3 + 2};
+    auto* bloom = padded + width * 4 + 2;
+    auto sourceRow = [this](int y) { return _source + std::clamp(y, 0, _height - 1) * _sourceStride; };
+
+    const int firstRow = band * BAND_ROWS;
+    const int lastRow = std::min(firstRow + BAND_ROWS, _height);
+    blurRow(sourceRow(firstRow - 1), width, padded, blurred[0]);
+    blurRow(sourceRow(firstRow), width, padded, blurred[1]);
+    for (int y = firstRow; y < lastRow; ++y) {
+        blurRow(sourceRow(y + 1), width, padded, blurred[2]);
+        blurColumns(blurred[0], blurred[1], blurred[2], width, bloom);
+        for (int row = 0; row < scale; ++row) {
+            emitRow(sourceRow(y), bloom, width, _rowWeights[row], _settings.bloomLevel, _destination + (y * scale + row) * _destinationStride, scale);
+        }
+        std::rotate(blurred, blurred + 1, blurred + 3);
+    }
+}
+
+}
@@ -0,0 +1,92 @@
+//---------------------------------------------------------------------------------------
+// src/emulation/crtfilter.hpp
+//---------------------------------------------------------------------------------------
+//
+// Copyright (c) 2015, Steffen Schümann <s.schuemann@pobox.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//---------------------------------------------------------------------------------------
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace emu {
+
+//---------------------------------------------------------------------------------------
+// CPU side CRT post-processing of a converted RGBA frame, every source pixel becomes a
+// scale x scale block with a scanline profile and a bit of bloom from its neighbours.
+// The output is processed in bands of source rows that are distributed over a small
+// pool of worker threads, the calling thread works on bands too.
+//---------------------------------------------------------------------------------------
+class CrtFilter
+{
+public:
+    struct Settings
+    {
+        int scale{4};                 // output pixels per source pixel in both directions
+        uint8_t scanlineLevel{144};   // brightness at the edge of a scanline, 255 disables scanlines
+        uint8_t bloomLevel{80};       // amount of blurred neighbour light added, 0 disables bloom
+    };
+    // numThreads includes the calling thread, 0 selects it from the available cores
+    explicit CrtFilter(int numThreads = 0);
+    ~CrtFilter();
+    CrtFilter(const CrtFilter&) = delete;
+    CrtFilter& operator=(const CrtFilter&) = delete;
+
+    void setSettings(const Settings& settings);
+    const Settings& settings() const { return _settings; }
+    int numThreads() const { return int(_workers.size()) + 1; }
+
+    // Renders width x height source pixels into destination, that must have room for
+    // width*scale x height*scale pixels, strides are given in pixels
+    void process(const uint32_t* source, int width, int height, int sourceStride, uint32_t* destination, int destinationStride);
+
+private:
+    void worker();
+    void processBands(uint32_t generation, std::vector<uint32_t>& scratch);
+    void processBand(int band, std::vector<uint32_t>& scratch);
+
+    Settings _settings;
+    std::vector<uint16_t> _rowWeights;
+    const uint32_t* _source{nullptr};
+    uint32_t* _destination{nullptr};
+    int _width{0};
+    int _height{0};
+    int _sourceStride{0};
+    int _destinationStride{0};
+    // generation (high 32 bits), band count (16 bits) and next band to claim (low 16 bits),
+    // a single word so a worker that is late for a frame can't claim a band of the next one
+    std::atomic<uint64_t> _work{0};
+    std::atomic_int _bandsDone{0};
+    std::vector<uint32_t> _scratch;
+    std::vector<std::thread> _workers;
+    std::mutex _mutex;
+    std::condition_variable _startCondition;
+    std::condition_variable _doneCondition;
+    uint64_t _generation{0};
+    bool _shutdown{false};
+};
+
+}
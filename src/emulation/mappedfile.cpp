@@ -0,0 +1,161 @@
+//---------------------------------------------------------------------------------------
+// src/emulation/mappedfile.cpp
+//---------------------------------------------------------------------------------------
+//
+// Copyright (c) 2023, Steffen Schümann <s.schuemann@pobox.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//---------------------------------------------------------------------------------------
+#include <emulation/mappedfile.hpp>
+
+#include <ghc/fs_fwd.hpp>
+
+#include <fstream>
+#include <utility>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#define CADMIUM_MAPPED_WIN32
+#elif !defined(__EMSCRIPTEN__) && (defined(__unix__) || (defined(__APPLE__) && defined(__MACH__)))
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define CADMIUM_MAPPED_POSIX
+#endif
+
+namespace emu {
+
+namespace fs = ghc::filesystem;
+
+MappedFile::MappedFile(const std::string& filename, size_t maxSize, Mode mode)
+{
+#if defined(CADMIUM_MAPPED_POSIX)
+    if(mode == eMAPPED) {
+        auto fd = ::open(filename.c_str(), O_RDONLY);
+        if(fd < 0)
+            return;
+        struct stat st{};
+        if(::fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+            if(uint64_t(st.st_size) > maxSize || st.st_size == 0) {
+                ::close(fd);
+                return;
+            }
+            auto* addr = ::mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if(addr != MAP_FAILED) {
+                ::close(fd);
+                _mapping = addr;
+                _data = static_cast<const uint8_t*>(addr);
+                _size = size_t(st.st_size);
+                return;
+            }
+        }
+        ::close(fd);
+    }
+#elif defined(CADMIUM_MAPPED_WIN32)
+    if(mode == eMAPPED) {
+        auto file = ::CreateFileW(fs::path(filename).wstring().c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if(file == INVALID_HANDLE_VALUE)
+            return;
+        LARGE_INTEGER fileSize{};
+        if(::GetFileSizeEx(file, &fileSize) && uint64_t(fileSize.QuadPart) <= maxSize && fileSize.QuadPart > 0) {
+            auto mapping = ::CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if(mapping) {
+                auto* addr = ::MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+                ::CloseHandle(mapping);
+                if(addr) {
+                    ::CloseHandle(file);
+                    _mapping = addr;
+                    _data = static_cast<const uint8_t*>(addr);
+                    _size = size_t(fileSize.QuadPart);
+                    return;
+                }
+            }
+        }
+        ::CloseHandle(file);
+        if(uint64_t(fileSize.QuadPart) > maxSize)
+            return;
+    }
+#else
+    (void)mode;
+#endif
+    // buffered fallback, also used for files that can't be mapped or shouldn't be
+    std::ifstream is(filename, std::ios::binary | std::ios::ate);
+    if(!is)
+        return;
+    auto size = is.tellg();
+    if(size <= 0 || uint64_t(size) > maxSize)
+        return;
+    is.seekg(0, std::ios::beg);
+    _buffer.resize(size_t(size));
+    if(!is.read((char*)_buffer.data(), size)) {
+        _buffer.clear();
+        return;
+    }
+    _data = _buffer.data();
+    _size = _buffer.size();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+{
+    *this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+    if(this != &other) {
+        unmap();
+        _mapping = std::exchange(other._mapping, nullptr);
+        _size = std::exchange(other._size, 0);
+        _buffer = std::move(other._buffer);
+        _data = _mapping ? other._data : (_buffer.empty() ? nullptr : _buffer.data());
+        other._data = nullptr;
+        other._buffer.clear();
+    }
+    return *this;
+}
+
+MappedFile::~MappedFile()
+{
+    unmap();
+}
+
+void MappedFile::unmap()
+{
+    if(_mapping) {
+#if defined(CADMIUM_MAPPED_POSIX)
+        ::munmap(_mapping, _size);
+#elif defined(CADMIUM_MAPPED_WIN32)
+        ::UnmapViewOfFile(_mapping);
+#endif
+        _mapping = nullptr;
+    }
+    _buffer.clear();
+    _data = nullptr;
+    _size = 0;
+}
+
+}  // namespace emu
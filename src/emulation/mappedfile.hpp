@@ -0,0 +1,73 @@
+//---------------------------------------------------------------------------------------
+// src/emulation/mappedfile.hpp
+//---------------------------------------------------------------------------------------
+//
+// Copyright (c) 2023, Steffen Schümann <s.schuemann@pobox.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//---------------------------------------------------------------------------------------
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace emu {
+
+//---------------------------------------------------------------------------------------
+// Read-only view of a whole file, memory mapped where the platform supports it, so ROMs
+// and sources can be hashed, decoded and copied to emulator memory without an extra
+// buffer. Where mapping isn't available or fails (emscripten, special files), the file
+// is read into an owned buffer instead, users only ever see data() and size().
+//
+// A mapped file that gets truncated by another process while it is mapped raises SIGBUS
+// on access past the new end, so code reading files that might be rewritten underneath
+// it (background analysis of watched directories) should request eBUFFERED.
+//---------------------------------------------------------------------------------------
+class MappedFile
+{
+public:
+    enum Mode { eMAPPED, eBUFFERED };
+    MappedFile() = default;
+    // Opens the file, files larger than maxSize or that can't be read result in an empty view
+    explicit MappedFile(const std::string& filename, size_t maxSize = SIZE_MAX, Mode mode = eMAPPED);
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile();
+
+    const uint8_t* data() const { return _data; }
+    size_t size() const { return _size; }
+    bool empty() const { return _size == 0; }
+    bool isMapped() const { return _mapping != nullptr; }
+    const uint8_t* begin() const { return _data; }
+    const uint8_t* end() const { return _data + _size; }
+
+private:
+    void unmap();
+    const uint8_t* _data{nullptr};
+    size_t _size{0};
+    void* _mapping{nullptr};
+    std::vector<uint8_t> _buffer;
+};
+
+}  // namespace emu
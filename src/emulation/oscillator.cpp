@@ -0,0 +1,195 @@
+//---------------------------------------------------------------------------------------
+// src/emulation/oscillator.cpp
+//---------------------------------------------------------------------------------------
+//
+// Copyright (c) 2023, Steffen Schümann <s.schuemann@pobox.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//---------------------------------------------------------------------------------------
+
+#include <emulation/oscillator.hpp>
+
+#include <cstring>
+
+namespace emu {
+namespace oscillator {
+
+//---------------------------------------------------------------------------------------
+// PolyBLEP residual of a unit step at phase 0, `distance` is the fixed point phase
+// relative to the edge and the window covers one phase step on either side. The
+// result is in [-1, 0] after the edge and in [0, 1] before it, scaled by half the
+// height of the step it is added to the naive signal.
+//---------------------------------------------------------------------------------------
+static inline float polyBlep(uint32_t distance, uint32_t window, float invWindow)
+{
+    if(distance < window) {
+        float t = float(distance) * invWindow;
+        return t + t - t * t - 1.0f;
+    }
+    uint32_t before = uint32_t(0) - distance;
+    if(before < window) {
+        float t = -float(before) * invWindow;
+        return t * t + t + t + 1.0f;
+    }
+    return 0.0f;
+}
+
+void renderSquare(int16_t* samples, size_t frames, uint32_t& phase, uint32_t step, int16_t amplitude)
+{
+    // the window is limited to a quarter period, so the corrections of both edges never overlap
+    const uint32_t window = std::min(step, uint32_t(0x40000000));
+    const float invWindow = window ? 1.0f / float(window) : 0.0f;
+    const float level = amplitude;
+    uint32_t p = phase;
+    if(!window) {
+        std::fill(samples, samples + frames, int16_t(p > 0x80000000u ? amplitude : -amplitude));
+        return;
+    }
+    for(size_t i = 0; i < frames; ++i, p += step) {
+        float value = p > 0x80000000u ? 1.0f : -1.0f;
+        value -= polyBlep(p, window, invWindow);
+        value += polyBlep(p - 0x80000000u, window, invWindow);
+        samples[i] = int16_t(value * level);
+    }
+    phase = p;
+}
+
+// one bit of the pattern covers 2^25 of the phase, the window is limited to half a bit
+static constexpr uint32_t BIT_SHIFT = 25;
+static constexpr uint32_t BIT_LENGTH = 1u << BIT_SHIFT;
+
+struct PatternShape
+{
+    PatternShape(const uint8_t* pattern, uint32_t step)
+        : window(std::min(step, BIT_LENGTH / 2))
+        , invWindow(window ? 1.0f / float(window) : 0.0f)
+    {
+        for(int i = 0; i < 128; ++i) {
+            levels[i] = (pattern[i >> 3] & (0x80 >> (i & 7))) ? 1.0f : -1.0f;
+        }
+    }
+    float valueAt(uint32_t p) const
+    {
+        const uint32_t pos = p >> BIT_SHIFT;
+        const uint32_t offset = p & (BIT_LENGTH - 1);
+        float value = levels[pos];
+        if(offset < window) {
+            // just behind the edge into the current bit
+            value += (value - levels[(pos - 1) & 127]) * 0.5f * polyBlep(offset, window, invWindow);
+        }
+        else if(BIT_LENGTH - offset < window) {
+            // just before the edge into the next bit
+            value += (levels[(pos + 1) & 127] - value) * 0.5f * polyBlep(offset - BIT_LENGTH, window, invWindow);
+        }
+        return value;
+    }
+    float levels[128];
+    uint32_t window;
+    float invWindow;
+};
+
+void renderPattern(int16_t* samples, size_t frames, uint32_t& phase, uint32_t step, const uint8_t* pattern, int16_t amplitude)
+{
+    const PatternShape shape(pattern, step);
+    const float level = amplitude;
+    uint32_t p = phase;
+    for(size_t i = 0; i < frames; ++i, p += step) {
+        samples[i] = int16_t(shape.valueAt(p) * level);
+    }
+    phase = p;
+}
+
+void PatternTableCache::render(int16_t* samples, size_t frames, uint32_t& phase, uint32_t step, const uint8_t* pattern, int16_t amplitude)
+{
+    const auto* found = tableFor(step, pattern, amplitude);
+    if(!found) {
+        renderPattern(samples, frames, phase, step, pattern, amplitude);
+        return;
+    }
+    const auto& table = *found;
+    const int16_t* data = table.samples.data();
+    const int shift = table.shift;
+    // entry i holds the value at phase i << shift, rounding the phase picks the nearest one
+    const uint32_t round = shift ? 1u << (shift - 1) : 0;
+    const uint32_t mask = uint32_t(table.samples.size() - 1);
+    uint32_t p = phase;
+    for(size_t i = 0; i < frames; ++i, p += step) {
+        samples[i] = data[((p + round) >> shift) & mask];
+    }
+    phase = p;
+}
+
+const PatternTableCache::Table* PatternTableCache::tableFor(uint32_t step, const uint8_t* pattern, int16_t amplitude)
+{
+    auto sameSound = [&](const auto& entry) {
+        return entry.step == step && entry.amplitude == amplitude && !std::memcmp(entry.pattern.data(), pattern, 16);
+    };
+    auto matches = [&](const Table& table) { return !table.samples.empty() && sameSound(table); };
+    ++_useCounter;
+    if(_current && matches(*_current)) {
+        return _current;
+    }
+    Table* table = nullptr;
+    for(auto& candidate : _tables) {
+        if(matches(candidate)) {
+            table = &candidate;
+            break;
+        }
+    }
+    if(!table) {
+        // a table is only worth building when the sound is used again soon, so the first
+        // use is only noted, replacing the least recently seen candidate
+        auto candidate = std::find_if(_candidates.begin(), _candidates.end(), [&](const Candidate& entry) { return entry.lastUse && sameSound(entry); });
+        if(candidate == _candidates.end() || candidate->lastUse + CANDIDATE_BLOCKS < _useCounter) {
+            if(candidate == _candidates.end())
+                candidate = std::min_element(_candidates.begin(), _candidates.end(), [](const Candidate& a, const Candidate& b) { return a.lastUse < b.lastUse; });
+            std::memcpy(candidate->pattern.data(), pattern, 16);
+            candidate->step = step;
+            candidate->amplitude = amplitude;
+            candidate->lastUse = _useCounter;
+            _current = nullptr;
+            return nullptr;
+        }
+        candidate->lastUse = 0;
+        table = &*std::min_element(_tables.begin(), _tables.end(), [](const Table& a, const Table& b) { return a.lastUse < b.lastUse; });
+        // at least two entries per output sample, so the nearest entry is within a quarter sample
+        int bits = MIN_TABLE_BITS;
+        while(bits < MAX_TABLE_BITS && step && (uint64_t(1) << 32) / step * 2 > (uint64_t(1) << bits)) {
+            ++bits;
+        }
+        std::memcpy(table->pattern.data(), pattern, 16);
+        table->step = step;
+        table->amplitude = amplitude;
+        table->shift = 32 - bits;
+        table->samples.resize(size_t(1) << bits);
+        const PatternShape shape(pattern, step);
+        const float level = amplitude;
+        for(size_t i = 0; i < table->samples.size(); ++i) {
+            table->samples[i] = int16_t(shape.valueAt(uint32_t(i << table->shift)) * level);
+        }
+        ++_tablesBuilt;
+    }
+    table->lastUse = _useCounter;
+    _current = table;
+    return table;
+}
+
+}  // namespace oscillator
+}  // namespace emu
@@ -0,0 +1,107 @@
+//---------------------------------------------------------------------------------------
+// src/emulation/oscillator.hpp
+//---------------------------------------------------------------------------------------
+//
+// Copyright (c) 2023, Steffen Schümann <s.schuemann@pobox.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//---------------------------------------------------------------------------------------
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace emu {
+
+//---------------------------------------------------------------------------------------
+// Block based oscillators for the 1-bit sound of the CHIP-8 variants. The phase is a
+// 32-bit fixed point fraction of a period, so wrapping around is free and there is no
+// drift from repeated float rounding. Every hard edge gets a PolyBLEP correction, so
+// high tones no longer alias into audible undertones.
+//---------------------------------------------------------------------------------------
+namespace oscillator {
+
+static constexpr int16_t DEFAULT_AMPLITUDE = 16384;
+
+// Phase increment per sample for a period of the given frequency
+inline uint32_t phaseStep(double frequency, int sampleFrequency)
+{
+    if(frequency <= 0.0 || sampleFrequency <= 0)
+        return 0;
+    return uint32_t(std::min(frequency / sampleFrequency * 4294967296.0, 4294967295.0));
+}
+
+// Square wave that is low in the first and high in the second half of the period
+void renderSquare(int16_t* samples, size_t frames, uint32_t& phase, uint32_t step, int16_t amplitude = DEFAULT_AMPLITUDE);
+
+// XO-CHIP style 1-bit pattern of 128 bits (16 bytes, MSB first) played once per period
+void renderPattern(int16_t* samples, size_t frames, uint32_t& phase, uint32_t step, const uint8_t* pattern, int16_t amplitude = DEFAULT_AMPLITUDE);
+
+//---------------------------------------------------------------------------------------
+// Cache of band-limited single period tables of XO-CHIP patterns. A table holds one
+// period of renderPattern output for a pattern and pitch with at least two entries
+// per output sample, so playback is a walk through the table. Tables are only built
+// for sounds that come back within a few blocks, tracked in a short list of recently
+// seen ones, so ROMs that change pattern or pitch (F002/Fx3A) every frame are rendered
+// directly. The last few tables are kept, as music ROMs tend to cycle through a small
+// set of patterns.
+//---------------------------------------------------------------------------------------
+class PatternTableCache
+{
+public:
+    static constexpr int NUM_TABLES = 4;
+    static constexpr int MIN_TABLE_BITS = 8;
+    static constexpr int MAX_TABLE_BITS = 14;
+    static constexpr int NUM_CANDIDATES = 8;
+    static constexpr uint64_t CANDIDATE_BLOCKS = 16;  // a second use within this many blocks builds a table
+
+    void render(int16_t* samples, size_t frames, uint32_t& phase, uint32_t step, const uint8_t* pattern, int16_t amplitude = DEFAULT_AMPLITUDE);
+    size_t tablesBuilt() const { return _tablesBuilt; }
+
+private:
+    struct Table
+    {
+        std::array<uint8_t, 16> pattern{};
+        uint32_t step{0};
+        int16_t amplitude{0};
+        int shift{32};
+        uint64_t lastUse{0};
+        std::vector<int16_t> samples;
+    };
+    struct Candidate
+    {
+        std::array<uint8_t, 16> pattern{};
+        uint32_t step{0};
+        int16_t amplitude{0};
+        uint64_t lastUse{0};
+    };
+    const Table* tableFor(uint32_t step, const uint8_t* pattern, int16_t amplitude);
+    std::array<Table, NUM_TABLES> _tables{};
+    std::array<Candidate, NUM_CANDIDATES> _candidates{};
+    const Table* _current{nullptr};
+    uint64_t _useCounter{0};
+    size_t _tablesBuilt{0};
+};
+
+}  // namespace oscillator
+}  // namespace emu
@@ -0,0 +1,373 @@
+//---------------------------------------------------------------------------------------
+// src/emulation/sha1hasher.cpp
+//---------------------------------------------------------------------------------------
+//
+// Copyright (c) 2015, Steffen Schümann <s.schuemann@pobox.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//---------------------------------------------------------------------------------------
+#include <emulation/sha1hasher.hpp>
+#include <emulation/simd.hpp>
+
+#include <sha1/sha1.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+#if defined(CADMIUM_WITH_SSE2) && !defined(__EMSCRIPTEN__) && (defined(_MSC_VER) || defined(__GNUC__) || defined(__clang__))
+#define CADMIUM_WITH_SHA_NI
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define CADMIUM_TARGET_SHA_NI
+#else
+#include <cpuid.h>
+#define CADMIUM_TARGET_SHA_NI __attribute__((target("sha,sse4.1,ssse3")))
+#endif
+#endif
+
+namespace emu {
+
+static const uint32_t INITIAL_STATE[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+
+// Whole blocks fed to a fresh sha1 object only run its block function, so this is the
+// plain implementation from external/sha1 working on our state
+static void compressScalar(uint32_t* state, const uint8_t* blocks, size_t numBlocks)
+{
+    static constexpr size_t MAX_CHUNK_BLOCKS = 65536;
+    sha1 sum;
+    std::memcpy(sum.state, state, sizeof(sum.state));
+    while(numBlocks) {
+        auto chunk = std::min(numBlocks, MAX_CHUNK_BLOCKS);
+        sum.add(blocks, uint32_t(chunk * 64));
+        blocks += chunk * 64;
+        numBlocks -= chunk;
+    }
+    std::memcpy(state, sum.state, sizeof(sum.state));
+}
+
+#ifdef CADMIUM_WITH_SHA_NI
+
+static bool cpuHasShaNi()
+{
+#ifdef _MSC_VER
+    int regs[4];
+    __cpuid(regs, 0);
+    if(regs[0] < 7)
+        return false;
+    __cpuid(regs, 1);
+    bool hasSse41AndSsse3 = (regs[2] & (1 << 19)) && (regs[2] & (1 << 9));
+    __cpuidex(regs, 7, 0);
+    return hasSse41AndSsse3 && (regs[1] & (1 << 29));
+#else
+    unsigned eax, ebx, ecx, edx;
+    if(!__get_cpuid(1, &eax, &ebx, &ecx, &edx) || !(ecx & (1u << 19)) || !(ecx & (1u << 9)))
+        return false;
+    if(!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx))
+        return false;
+    return (ebx & (1u << 29)) != 0;
+#endif
+}
+
+// One group of four rounds, msg[] holds the message schedule in a ring of four
+// registers and e[] alternates between the E values of even and odd groups
+#define SHA1_NI_GROUP(g)                                                   \
+    e[(g) & 1] = _mm_sha1nexte_epu32(e[(g) & 1], msg[(g) & 3]);            \
+    e[((g) + 1) & 1] = abcd;                                               \
+    if((g) >= 3 && (g) <= 18)                                              \
+        msg[((g) + 1) & 3] = _mm_sha1msg2_epu32(msg[((g) + 1) & 3], msg[(g) & 3]); \
+    abcd = _mm_sha1rnds4_epu32(abcd, e[(g) & 1], (g) / 5);                 \
+    if((g) <= 16)                                                          \
+        msg[((g) + 3) & 3] = _mm_sha1msg1_epu32(msg[((g) + 3) & 3], msg[(g) & 3]); \
+    if((g) >= 2 && (g) <= 17)                                             \
+        msg[((g) + 2) & 3] = _mm_xor_si128(msg[((g) + 2) & 3], msg[(g) & 3]);
+
+CADMIUM_TARGET_SHA_NI
+static void compressShaNi(uint32_t* state, const uint8_t* blocks, size_t numBlocks)
+{
+    const __m128i byteSwap = _mm_set_epi64x(0x0001020304050607ULL, 0x08090a0b0c0d0e0fULL);
+    __m128i abcd = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)state), 0x1B);
+    __m128i e0 = _mm_set_epi32(int(state[4]), 0, 0, 0);
+    for(; numBlocks; --numBlocks, blocks += 64) {
+        const __m128i abcdSaved = abcd;
+        const __m128i e0Saved = e0;
+        __m128i msg[4], e[2];
+        for(int i = 0; i < 4; ++i)
+            msg[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(blocks + i * 16)), byteSwap);
+        e[0] = _mm_add_epi32(e0, msg[0]);
+        e[1] = abcd;
+        abcd = _mm_sha1rnds4_epu32(abcd, e[0], 0);
+        SHA1_NI_GROUP(1) SHA1_NI_GROUP(2) SHA1_NI_GROUP(3) SHA1_NI_GROUP(4)
+        SHA1_NI_GROUP(5) SHA1_NI_GROUP(6) SHA1_NI_GROUP(7) SHA1_NI_GROUP(8)
+        SHA1_NI_GROUP(9) SHA1_NI_GROUP(10) SHA1_NI_GROUP(11) SHA1_NI_GROUP(12)
+        SHA1_NI_GROUP(13) SHA1_NI_GROUP(14) SHA1_NI_GROUP(15) SHA1_NI_GROUP(16)
+        SHA1_NI_GROUP(17) SHA1_NI_GROUP(18) SHA1_NI_GROUP(19)
+        e0 = _mm_sha1nexte_epu32(e[0], e0Saved);
+        abcd = _mm_add_epi32(abcd, abcdSaved);
+    }
+    _mm_storeu_si128((__m128i*)state, _mm_shuffle_epi32(abcd, 0x1B));
+    state[4] = uint32_t(_mm_extract_epi32(e0, 3));
+}
+
+#undef SHA1_NI_GROUP
+
+#else
+
+static bool cpuHasShaNi()
+{
+    return false;
+}
+
+#endif
+
+#ifdef CADMIUM_WITH_SSE2
+
+//---------------------------------------------------------------------------------------
+// Multi-buffer: four messages are compressed side by side, each in one 32-bit lane.
+// Every lane walks the full blocks of its input and then one or two padded tail
+// blocks, a lane that is done takes the next input, idle lanes hash a dummy block.
+//---------------------------------------------------------------------------------------
+template<int N>
+static inline __m128i rotateLeft(__m128i x)
+{
+    return _mm_or_si128(_mm_slli_epi32(x, N), _mm_srli_epi32(x, 32 - N));
+}
+
+// SSE2 has no byte shuffle, so bytes are swapped in the 16-bit halves, then the halves
+static inline __m128i byteSwap32(__m128i x)
+{
+    x = _mm_or_si128(_mm_slli_epi16(x, 8), _mm_srli_epi16(x, 8));
+    return _mm_shufflehi_epi16(_mm_shufflelo_epi16(x, 0xB1), 0xB1);
+}
+
+static void compressLanes(uint32_t (&state)[5][4], const uint8_t* const (&blocks)[4])
+{
+    __m128i w[16];
+    for(int q = 0; q < 4; ++q) {
+        // transpose four words of each block into one register per word, then swap the bytes
+        auto r0 = _mm_loadu_si128((const __m128i*)(blocks[0] + q * 16));
+        auto r1 = _mm_loadu_si128((const __m128i*)(blocks[1] + q * 16));
+        auto r2 = _mm_loadu_si128((const __m128i*)(blocks[2] + q * 16));
+        auto r3 = _mm_loadu_si128((const __m128i*)(blocks[3] + q * 16));
+        auto t0 = _mm_unpacklo_epi32(r0, r1), t1 = _mm_unpacklo_epi32(r2, r3);
+        auto t2 = _mm_unpackhi_epi32(r0, r1), t3 = _mm_unpackhi_epi32(r2, r3);
+        w[q * 4 + 0] = byteSwap32(_mm_unpacklo_epi64(t0, t1));
+        w[q * 4 + 1] = byteSwap32(_mm_unpackhi_epi64(t0, t1));
+        w[q * 4 + 2] = byteSwap32(_mm_unpacklo_epi64(t2, t3));
+        w[q * 4 + 3] = byteSwap32(_mm_unpackhi_epi64(t2, t3));
+    }
+    __m128i a = _mm_loadu_si128((const __m128i*)state[0]);
+    __m128i b = _mm_loadu_si128((const __m128i*)state[1]);
+    __m128i c = _mm_loadu_si128((const __m128i*)state[2]);
+    __m128i d = _mm_loadu_si128((const __m128i*)state[3]);
+    __m128i e = _mm_loadu_si128((const __m128i*)state[4]);
+    auto round = [&](int t, __m128i f, __m128i k) {
+        if(t >= 16)
+            w[t & 15] = rotateLeft<1>(_mm_xor_si128(_mm_xor_si128(w[(t + 13) & 15], w[(t + 8) & 15]), _mm_xor_si128(w[(t + 2) & 15], w[t & 15])));
+        auto temp = _mm_add_epi32(_mm_add_epi32(rotateLeft<5>(a), f), _mm_add_epi32(_mm_add_epi32(e, k), w[t & 15]));
+        e = d;
+        d = c;
+        c = rotateLeft<30>(b);
+        b = a;
+        a = temp;
+    };
+    const auto k0 = _mm_set1_epi32(0x5a827999), k1 = _mm_set1_epi32(0x6ed9eba1), k2 = _mm_set1_epi32(int(0x8f1bbcdc)), k3 = _mm_set1_epi32(int(0xca62c1d6));
+    for(int t = 0; t < 20; ++t)
+        round(t, _mm_xor_si128(d, _mm_and_si128(b, _mm_xor_si128(c, d))), k0);
+    for(int t = 20; t < 40; ++t)
+        round(t, _mm_xor_si128(_mm_xor_si128(b, c), d), k1);
+    for(int t = 40; t < 60; ++t)
+        round(t, _mm_or_si128(_mm_and_si128(b, c), _mm_and_si128(d, _mm_or_si128(b, c))), k2);
+    for(int t = 60; t < 80; ++t)
+        round(t, _mm_xor_si128(_mm_xor_si128(b, c), d), k3);
+    _mm_storeu_si128((__m128i*)state[0], _mm_add_epi32(a, _mm_loadu_si128((const __m128i*)state[0])));
+    _mm_storeu_si128((__m128i*)state[1], _mm_add_epi32(b, _mm_loadu_si128((const __m128i*)state[1])));
+    _mm_storeu_si128((__m128i*)state[2], _mm_add_epi32(c, _mm_loadu_si128((const __m128i*)state[2])));
+    _mm_storeu_si128((__m128i*)state[3], _mm_add_epi32(d, _mm_loadu_si128((const __m128i*)state[3])));
+    _mm_storeu_si128((__m128i*)state[4], _mm_add_epi32(e, _mm_loadu_si128((const __m128i*)state[4])));
+}
+
+static void hashLanes(const Sha1Hasher::Input* inputs, size_t count, Sha1Hasher::State* results)
+{
+    struct Lane
+    {
+        size_t input;
+        size_t fullBlocks;
+        size_t totalBlocks;
+        size_t nextBlock;
+        uint8_t tail[128];
+    };
+    static const uint8_t idleBlock[64] = {};
+    Lane lanes[4];
+    uint32_t state[5][4];
+    size_t nextInput = 0;
+    auto startLane = [&](int l) {
+        auto& lane = lanes[l];
+        lane.input = nextInput < count ? nextInput++ : count;
+        lane.nextBlock = 0;
+        if(lane.input == count) {
+            lane.fullBlocks = lane.totalBlocks = 0;
+            return;
+        }
+        const auto& input = inputs[lane.input];
+        lane.fullBlocks = input.size / 64;
+        auto rest = input.size % 64;
+        lane.totalBlocks = lane.fullBlocks + (rest < 56 ? 1 : 2);
+        std::memset(lane.tail, 0, sizeof(lane.tail));
+        if(rest)
+            std::memcpy(lane.tail, input.data + lane.fullBlocks * 64, rest);
+        lane.tail[rest] = 0x80;
+        auto bits = uint64_t(input.size) * 8;
+        auto* end = lane.tail + (lane.totalBlocks - lane.fullBlocks) * 64;
+        for(int i = 1; i <= 8; ++i, bits >>= 8)
+            end[-i] = uint8_t(bits);
+        for(int i = 0; i < 5; ++i)
+            state[i][l] = INITIAL_STATE[i];
+    };
+    for(int l = 0; l < 4; ++l)
+        startLane(l);
+    while(true) {
+        const uint8_t* blocks[4];
+        bool active = false;
+        for(int l = 0; l < 4; ++l) {
+            const auto& lane = lanes[l];
+            if(lane.input == count)
+                blocks[l] = idleBlock;
+            else {
+                blocks[l] = lane.nextBlock < lane.fullBlocks ? inputs[lane.input].data + lane.nextBlock * 64 : lane.tail + (lane.nextBlock - lane.fullBlocks) * 64;
+                active = true;
+            }
+        }
+        if(!active)
+            break;
+        compressLanes(state, blocks);
+        for(int l = 0; l < 4; ++l) {
+            auto& lane = lanes[l];
+            if(lane.input != count && ++lane.nextBlock == lane.totalBlocks) {
+                for(int i = 0; i < 5; ++i)
+                    results[lane.input][i] = state[i][l];
+                startLane(l);
+            }
+        }
+    }
+}
+
+#endif
+
+static std::atomic<int>& selectedBackend()
+{
+    static std::atomic<int> backend{cpuHasShaNi() ? Sha1Hasher::eSHA_NI : Sha1Hasher::eSCALAR};
+    return backend;
+}
+
+Sha1Hasher::Backend Sha1Hasher::backend()
+{
+    return Backend(selectedBackend().load(std::memory_order_relaxed));
+}
+
+const char* Sha1Hasher::backendName(Backend backend)
+{
+    return backend == eSHA_NI ? "sha-ni" : "scalar";
+}
+
+bool Sha1Hasher::isSupported(Backend backend)
+{
+    static const bool hasShaNi = cpuHasShaNi();
+    return backend == eSCALAR || (backend == eSHA_NI && hasShaNi);
+}
+
+void Sha1Hasher::setBackend(Backend backend)
+{
+    if(isSupported(backend))
+        selectedBackend() = backend;
+}
+
+void Sha1Hasher::compress(State& state, const uint8_t* blocks, size_t numBlocks)
+{
+#ifdef CADMIUM_WITH_SHA_NI
+    if(backend() == eSHA_NI) {
+        compressShaNi(state.data(), blocks, numBlocks);
+        return;
+    }
+#endif
+    compressScalar(state.data(), blocks, numBlocks);
+}
+
+Sha1Hasher::Sha1Hasher()
+{
+    std::copy(std::begin(INITIAL_STATE), std::end(INITIAL_STATE), _state.begin());
+}
+
+Sha1Hasher& Sha1Hasher::add(const uint8_t* data, size_t size)
+{
+    _length += size;
+    if(_bufferSize) {
+        auto fill = std::min(size, sizeof(_buffer) - _bufferSize);
+        std::memcpy(_buffer + _bufferSize, data, fill);
+        _bufferSize += fill;
+        data += fill;
+        size -= fill;
+        if(_bufferSize < sizeof(_buffer))
+            return *this;
+        compress(_state, _buffer, 1);
+        _bufferSize = 0;
+    }
+    if(size >= 64) {
+        compress(_state, data, size / 64);
+        data += size & ~size_t(63);
+        size &= 63;
+    }
+    if(size) {
+        std::memcpy(_buffer, data, size);
+        _bufferSize = size;
+    }
+    return *this;
+}
+
+Sha1Hasher::State Sha1Hasher::finalize()
+{
+    auto bits = _length * 8;
+    uint8_t padding[72] = {0x80};
+    auto padSize = (_bufferSize < 56 ? 56 : 120) - _bufferSize;
+    for(int i = 0; i < 8; ++i)
+        padding[padSize + i] = uint8_t(bits >> (56 - i * 8));
+    add(padding, padSize + 8);
+    return _state;
+}
+
+Sha1Hasher::State Sha1Hasher::hash(const uint8_t* data, size_t size)
+{
+    return Sha1Hasher().add(data, size).finalize();
+}
+
+void Sha1Hasher::hashMany(const Input* inputs, size_t count, State* results)
+{
+#ifdef CADMIUM_WITH_SSE2
+    if(backend() != eSHA_NI && count > 1) {
+        hashLanes(inputs, count, results);
+        return;
+    }
+#endif
+    for(size_t i = 0; i < count; ++i)
+        results[i] = hash(inputs[i].data, inputs[i].size);
+}
+
+}  // namespace emu
@@ -0,0 +1,74 @@
+//---------------------------------------------------------------------------------------
+// src/emulation/sha1hasher.hpp
+//---------------------------------------------------------------------------------------
+//
+// Copyright (c) 2023, Steffen Schümann <s.schuemann@pobox.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//---------------------------------------------------------------------------------------
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace emu {
+
+//---------------------------------------------------------------------------------------
+// SHA1 with the block compression picked at runtime: x86 SHA extensions when the CPU
+// has them, the portable implementation from external/sha1 otherwise. Many small
+// inputs can be hashed at once, without SHA extensions that runs four messages in the
+// lanes of SSE2 registers, SSE2 is part of every x86_64 target.
+//---------------------------------------------------------------------------------------
+class Sha1Hasher
+{
+public:
+    using State = std::array<uint32_t, 5>;
+    enum Backend { eSCALAR, eSHA_NI };
+    struct Input
+    {
+        const uint8_t* data;
+        size_t size;
+    };
+
+    Sha1Hasher();
+    Sha1Hasher& add(const uint8_t* data, size_t size);
+    // Pads the message and returns the digest words, the hasher can't be used after that
+    State finalize();
+
+    static State hash(const uint8_t* data, size_t size);
+    // Hashes count independent inputs into results, which needs room for count states
+    static void hashMany(const Input* inputs, size_t count, State* results);
+
+    static Backend backend();
+    static const char* backendName(Backend backend);
+    static bool isSupported(Backend backend);
+    // Selects the block compression, unsupported backends are ignored, used to compare them
+    static void setBackend(Backend backend);
+
+private:
+    static void compress(State& state, const uint8_t* blocks, size_t numBlocks);
+    State _state;
+    uint8_t _buffer[64];
+    size_t _bufferSize{0};
+    uint64_t _length{0};
+};
+
+}  // namespace emu
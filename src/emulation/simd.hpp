@@ -0,0 +1,67 @@
+//---------------------------------------------------------------------------------------
+// src/emulation/simd.hpp
+//---------------------------------------------------------------------------------------
+//
+// Copyright (c) 2023, Steffen Schümann <s.schuemann@pobox.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//---------------------------------------------------------------------------------------
+#pragma once
+
+//---------------------------------------------------------------------------------------
+// SSE2 is part of every x86_64 target, so it is used without runtime dispatch, all
+// other targets (arm64 slices of universal builds, emscripten) use the scalar paths
+//---------------------------------------------------------------------------------------
+#if !defined(CADMIUM_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define CADMIUM_WITH_SSE2
+#include <emmintrin.h>
+#endif
+
+#include <cstdint>
+
+namespace emu {
+namespace simd {
+
+#ifdef CADMIUM_WITH_SSE2
+
+// Expands the lower four bytes of a byte mask (0x00/0xFF) to four 32-bit lane masks
+inline __m128i expandByteMaskLo(__m128i mask)
+{
+    auto m16 = _mm_unpacklo_epi8(mask, mask);
+    return _mm_unpacklo_epi16(m16, m16);
+}
+
+// Expands bytes four to seven of a byte mask (0x00/0xFF) to four 32-bit lane masks
+inline __m128i expandByteMaskHi(__m128i mask)
+{
+    auto m16 = _mm_unpacklo_epi8(mask, mask);
+    return _mm_unpackhi_epi16(m16, m16);
+}
+
+// (a & mask) | (b & ~mask), SSE2 has no blendv
+inline __m128i select(__m128i mask, __m128i a, __m128i b)
+{
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+#endif
+
+}  // namespace simd
+}  // namespace emu
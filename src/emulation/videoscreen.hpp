@@ -25,10 +25,16 @@
 //---------------------------------------------------------------------------------------
 #pragma once
 
+#include <emulation/simd.hpp>
+
+#include <algorithm>
 #include <array>
 #include <cstdint>
+#include <cstdlib>
+#include <cstring>
 #include <stdendian/stdendian.h>
 #include <set>
+#include <vector>
 
 namespace emu {
 
@@ -39,7 +45,14 @@ public:
     static constexpr int WIDTH = Width;
     static constexpr int HEIGHT = Height;
     VideoScreen()
+        : VideoScreen(Width, Height)
+    {
+    }
+    // A buffer size of 0x0 creates a screen without pixel buffer, it can be allocated
+    // later via setBufferSize, until then all operations on it are no-ops
+    VideoScreen(int bufferWidth, int bufferHeight)
     {
+        setBufferSize(bufferWidth, bufferHeight);
         _palette[0] = be32(0x00000000);
         _palette[1] = be32(0xFFFFFFFF);
         _palette[2] = be32(0xCCCCCCFF);
@@ -52,6 +65,25 @@ public:
         _height = height;
         _ratio = ratio > 0 ? ratio : (width/height/2);
     }
+    // Resizes the pixel buffer to the given maximum resolution that also becomes the
+    // stride, pixels that fit into the new size are kept, new ones are black
+    void setBufferSize(int width, int height)
+    {
+        if (width == _stride && height == bufferHeight())
+            return;
+        std::vector<PixelType> buffer(size_t(width) * height, _black);
+        for (int y = 0; y < std::min(height, bufferHeight()); ++y)
+            std::memcpy(buffer.data() + y * width, _screenBuffer.data() + y * _stride, std::min(width, _stride) * sizeof(PixelType));
+        _screenBuffer.swap(buffer);
+        _stride = width;
+        if (width && height) {
+            // never leave a mode that would reach past the buffer
+            _width = std::min(_width, width);
+            _height = std::min(_height, height);
+        }
+    }
+    int bufferHeight() const { return _stride ? int(_screenBuffer.size() / _stride) : 0; }
+    bool isAllocated() const { return !_screenBuffer.empty(); }
     void setOverlayCellHeight(int height) {
         _overlayCellHeight = height;
         if(_overlayCellHeight < 0) {
@@ -95,6 +127,8 @@ public:
     }
     void convert(uint32_t* destination, int destinationStride, uint8_t alpha, const VideoScreen<PixelType,Width,Height>* background = nullptr) const
     {
+        if(!isAllocated())
+            return;
         if(isRGBA() || !_overlayCellHeight) {
             if(!background) {
                 for (unsigned row = 0; row < _height; ++row) {
@@ -116,7 +150,7 @@ public:
             else {
                 for (unsigned row = 0; row < _height; ++row) {
                     auto srcPtr = _screenBuffer.data() + row * _stride;
-                    auto backPtr = background->_screenBuffer.data() + row * _stride;
+                    auto backPtr = background->_screenBuffer.data() + row * background->_stride;
                     auto dstPtr = destination + row * destinationStride;
                     for (unsigned x = 0; x < _width; ++x) {
                         auto srcCol = *srcPtr++;
@@ -131,79 +165,40 @@ public:
                 }
             }
         }
-        else {
-            for (unsigned row = 0; row < _height; ++row) {
-                auto srcPtr = _screenBuffer.data() + row * _stride;
-                auto dstPtr = destination + row * destinationStride;
-                auto overlayPtr = _colorOverlay.data() + (row/_overlayCellHeight)*_overlayCellHeight * 8;
-                for (unsigned x = 0; x < _width; ++x) {
-                    auto pxl = *srcPtr++;
-                    if(_overlayCellHeight < 0) {
-                        *dstPtr++ = pxl ? _palette[7+4] : _palette[_overlayBackground & 3];
-                    }
-                    else {
-                        *dstPtr++ = pxl ? _palette[overlayPtr[x >> 3] + 4] : _palette[_overlayBackground & 3];
-                    }
-                }
-            }
+        else if constexpr (!isRGBA()) {
+            convertWithOverlay(destination, destinationStride);
         }
     }
     void setAll(PixelType value)
     {
-        if constexpr (isRGBA()) {
-            for(auto& pixel : _screenBuffer)
-                pixel = value;
-        }
-        else {
-            std::memset(_screenBuffer.data(), value, Width * Height);
-        }
+        fillPixels(_screenBuffer.data(), _screenBuffer.size(), value);
     }
     void binaryAND(PixelType mask)
     {
-        for(auto& pixel : _screenBuffer)
-            pixel &= mask;
+        for (int y = 0; y < _height; ++y)
+            andPixels(_screenBuffer.data() + y * _stride, _width, mask);
     }
     void scrollDown(int n)
     {
-        std::memmove(_screenBuffer.data() + n * _stride, _screenBuffer.data(), (_screenBuffer.size() - n * _stride) * sizeof(PixelType));
-        if constexpr (isRGBA())
-            for(unsigned i = 0; i < n*_stride; ++i) _screenBuffer[i] = _black;
-        else
-            std::memset(_screenBuffer.data(), 0, n * _stride);
+        scrollArea(0, n);
     }
     void scrollUp(int n)
     {
-        std::memmove(_screenBuffer.data(), _screenBuffer.data() + n * _stride, (_screenBuffer.size() - n * _stride) * sizeof(PixelType));
-        if constexpr (isRGBA())
-            for(unsigned i = 0; i < n*_stride; ++i) _screenBuffer[_screenBuffer.size() - n * _stride + i] = _black;
-        else
-            std::memset(_screenBuffer.data() + _screenBuffer.size() - n * _stride, 0, n * _stride);
+        scrollArea(0, -n);
     }
     void scrollLeft(int n)
     {
-        for(int y = 0; y < Height; ++y) {
-            std::memmove(_screenBuffer.data() + y * _stride, _screenBuffer.data() + y * _stride + n, (_stride - n) * sizeof(PixelType));
-            if constexpr (isRGBA())
-                for(unsigned i = 0; i < n; ++i) _screenBuffer[y * _stride + _stride - n + i] = _black;
-            else
-                std::memset(_screenBuffer.data() + y * _stride + _stride - n, 0, n);
-        }
-
+        scrollArea(-n, 0);
     }
     void scrollRight(int n)
     {
-        for(int y = 0; y < Height; ++y) {
-            std::memmove(_screenBuffer.data() + y * _stride + n, _screenBuffer.data() + y * _stride, (_stride - n) * sizeof(PixelType));
-            if constexpr (isRGBA())
-                for(unsigned i = 0; i < n; ++i) _screenBuffer[y * _stride + i] = _black;
-            else
-                std::memset(_screenBuffer.data() + y * _stride, 0, n);
-        }
+        scrollArea(n, 0);
     }
     VideoScreen& operator=(const VideoScreen& other)
     {
         _width = other._width;
         _height = other._height;
+        _stride = other._stride;
         _screenBuffer = other._screenBuffer;
         _palette = other._palette;
         return *this;
@@ -274,6 +269,118 @@ public:
         _screenBuffer[y * _stride + x] &= ~mask;
     }
 protected:
+    static void fillPixels(PixelType* dst, size_t count, PixelType value)
+    {
+        if constexpr (isRGBA()) {
+#ifdef CADMIUM_WITH_SSE2
+            const auto val = _mm_set1_epi32(int(value));
+            for (; count >= 4; count -= 4, dst += 4)
+                _mm_storeu_si128((__m128i*)dst, val);
+#endif
+            while (count--)
+                *dst++ = value;
+        }
+        else {
+            std::memset(dst, value, count);
+        }
+    }
+    static void andPixels(PixelType* dst, size_t count, PixelType mask)
+    {
+#ifdef CADMIUM_WITH_SSE2
+        const auto msk = isRGBA() ? _mm_set1_epi32(int(mask)) : _mm_set1_epi8(char(mask));
+        constexpr size_t pixelsPerVector = 16 / sizeof(PixelType);
+        for (; count >= pixelsPerVector; count -= pixelsPerVector, dst += pixelsPerVector)
+            _mm_storeu_si128((__m128i*)dst, _mm_and_si128(_mm_loadu_si128((const __m128i*)dst), msk));
+#endif
+        while (count--)
+            *dst++ &= mask;
+    }
+    // Scrolls the visible area by dx/dy pixels and clears the vacated part, every line is
+    // moved and cleared in one go, so each cache line of the buffer is only touched once
+    void scrollArea(int dx, int dy)
+    {
+        if (!isAllocated())
+            return;
+        dx = std::clamp(dx, -_width, _width);
+        dy = std::clamp(dy, -_height, _height);
+        if (!dx && !dy)
+            return;
+        auto moveWidth = _width - std::abs(dx);
+        auto scrollLine = [&](int y) {
+            auto* dst = _screenBuffer.data() + y * _stride;
+            auto sy = y - dy;
+            if (sy < 0 || sy >= _height) {
+                fillPixels(dst, _width, _black);
+                return;
+            }
+            const auto* src = _screenBuffer.data() + sy * _stride;
+            if (dx >= 0) {
+                std::memmove(dst + dx, src, moveWidth * sizeof(PixelType));
+                fillPixels(dst, dx, _black);
+            }
+            else {
+                std::memmove(dst, src - dx, moveWidth * sizeof(PixelType));
+                fillPixels(dst + moveWidth, -dx, _black);
+            }
+        };
+        if (dy > 0) {
+            for (int y = _height - 1; y >= 0; --y)
+                scrollLine(y);
+        }
+        else {
+            for (int y = 0; y < _height; ++y)
+                scrollLine(y);
+        }
+    }
+    // CHIP-8X color overlay: the foreground color is constant for a cell of eight pixels,
+    // so it is resolved once per cell and the cell is expanded with a mask select
+    void convertWithOverlay(uint32_t* destination, int destinationStride) const
+    {
+        const auto background = _palette[_overlayBackground & 3];
+        if (_overlayCellHeight < 0) {
+            convertWithForeground(destination, destinationStride, _palette[7 + 4], background);
+            return;
+        }
+        for (int row = 0; row < _height; ++row) {
+            const auto* srcPtr = _screenBuffer.data() + row * _stride;
+            auto* dstPtr = destination + row * destinationStride;
+            const auto* overlayPtr = _colorOverlay.data() + (row / _overlayCellHeight) * _overlayCellHeight * 8;
+            int x = 0;
+            for (; x + 8 <= _width; x += 8) {
+                expandCell(dstPtr + x, srcPtr + x, _palette[overlayPtr[x >> 3] + 4], background);
+            }
+            for (; x < _width; ++x) {
+                dstPtr[x] = srcPtr[x] ? _palette[overlayPtr[x >> 3] + 4] : background;
+            }
+        }
+    }
+    void convertWithForeground(uint32_t* destination, int destinationStride, uint32_t foreground, uint32_t background) const
+    {
+        for (int row = 0; row < _height; ++row) {
+            const auto* srcPtr = _screenBuffer.data() + row * _stride;
+            auto* dstPtr = destination + row * destinationStride;
+            int x = 0;
+            for (; x + 8 <= _width; x += 8) {
+                expandCell(dstPtr + x, srcPtr + x, foreground, background);
+            }
+            for (; x < _width; ++x) {
+                dstPtr[x] = srcPtr[x] ? foreground : background;
+            }
+        }
+    }
+    static inline void expandCell(uint32_t* dst, const uint8_t* src, uint32_t foreground, uint32_t background)
+    {
+#ifdef CADMIUM_WITH_SSE2
+        const auto fg = _mm_set1_epi32(int(foreground));
+        const auto bg = _mm_set1_epi32(int(background));
+        auto unset = _mm_cmpeq_epi8(_mm_loadl_epi64((const __m128i*)src), _mm_setzero_si128());
+        _mm_storeu_si128((__m128i*)dst, simd::select(simd::expandByteMaskLo(unset), bg, fg));
+        _mm_storeu_si128((__m128i*)(dst + 4), simd::select(simd::expandByteMaskHi(unset), bg, fg));
+#else
+        for (int i = 0; i < 8; ++i)
+            dst[i] = src[i] ? foreground : background;
+#endif
+    }
     static inline uint32_t blend(uint32_t color, uint8_t  alpha)
     {
         auto newAlpha = (color >> 24) * alpha / 255;
@@ -290,7 +397,7 @@ protected:
         *dst++ = (a * *c2 + (255 - a) * *c1) >> 8;
         *dst = 255;
     }
-    const int _stride{Width};
+    int _stride{0};
     int _width{Width};
     int _height{Height};
     int _ratio{1};
@@ -298,7 +405,7 @@ protected:
     int _overlayBackground{0};
     PixelType _black{isRGBA() ? be32(0x00000000) : 0};
     PixelType _white{isRGBA() ? be32(0xFFFFFFFF) : 1};
-    std::array<PixelType, Width*Height> _screenBuffer;
+    std::vector<PixelType> _screenBuffer;
     std::array<uint32_t, 256> _palette{};
     std::array<uint8_t, 256> _colorOverlay{};
 };
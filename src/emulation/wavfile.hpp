@@ -0,0 +1,98 @@
+//---------------------------------------------------------------------------------------
+// src/emulation/wavfile.hpp
+//---------------------------------------------------------------------------------------
+//
+// Copyright (c) 2023, Steffen Schümann <s.schuemann@pobox.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//---------------------------------------------------------------------------------------
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace emu {
+
+//---------------------------------------------------------------------------------------
+// Minimal RIFF/WAVE support for mono 16-bit PCM, used for the headless audio dumps
+// and the audio regression tests.
+//---------------------------------------------------------------------------------------
+inline bool writeWavFile(const std::string& filename, const int16_t* samples, size_t frames, int sampleFrequency)
+{
+    std::vector<uint8_t> wav;
+    wav.reserve(44 + frames * 2);
+    auto append = [&wav](uint32_t value, int bytes) {
+        while(bytes--) {
+            wav.push_back(value & 0xff);
+            value >>= 8;
+        }
+    };
+    auto appendTag = [&wav](const char* tag) { wav.insert(wav.end(), tag, tag + 4); };
+    appendTag("RIFF");
+    append(uint32_t(36 + frames * 2), 4);
+    appendTag("WAVE");
+    appendTag("fmt ");
+    append(16, 4);                       // chunk size
+    append(1, 2);                        // PCM
+    append(1, 2);                        // mono
+    append(sampleFrequency, 4);
+    append(sampleFrequency * 2, 4);      // bytes per second
+    append(2, 2);                        // block align
+    append(16, 2);                       // bits per sample
+    appendTag("data");
+    append(uint32_t(frames * 2), 4);
+    for(size_t i = 0; i < frames; ++i) {
+        append(uint16_t(samples[i]), 2);
+    }
+    std::ofstream os(filename, std::ios::binary | std::ios::trunc);
+    return bool(os.write((const char*)wav.data(), wav.size()));
+}
+
+// Reads the samples of a file written by writeWavFile, returns an empty vector on any other format
+inline std::vector<int16_t> readWavFile(const std::string& filename, int* sampleFrequency = nullptr)
+{
+    std::ifstream is(filename, std::ios::binary);
+    uint8_t header[44];
+    if(!is.read((char*)header, sizeof(header)))
+        return {};
+    auto value = [&header](int offset, int bytes) {
+        uint32_t result = 0;
+        while(bytes--)
+            result = (result << 8) | header[offset + bytes];
+        return result;
+    };
+    if(std::string((const char*)header, 4) != "RIFF" || std::string((const char*)header + 8, 8) != "WAVEfmt " || value(20, 2) != 1 || value(22, 2) != 1 || value(34, 2) != 16 || std::string((const char*)header + 36, 4) != "data")
+        return {};
+    if(sampleFrequency)
+        *sampleFrequency = int(value(24, 4));
+    std::vector<uint8_t> data(value(40, 4));
+    if(!is.read((char*)data.data(), data.size()))
+        return {};
+    std::vector<int16_t> samples(data.size() / 2);
+    for(size_t i = 0; i < samples.size(); ++i) {
+        samples[i] = int16_t(data[i * 2] | (data[i * 2 + 1] << 8));
+    }
+    return samples;
+}
+
+}  // namespace emu
@@ -0,0 +1,209 @@
+//---------------------------------------------------------------------------------------
+// src/frametelemetry.hpp
+//---------------------------------------------------------------------------------------
+//
+// Copyright (c) 2023, Steffen Schümann <s.schuemann@pobox.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//---------------------------------------------------------------------------------------
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <ostream>
+#include <string>
+
+#include <nlohmann/json.hpp>
+
+//---------------------------------------------------------------------------------------
+// Per frame timing of the host, the sections can be timed from the UI and from the
+// emulation thread, they are summed up in atomics and moved to a fixed size history
+// ring by endFrame(), that is only ever called from the thread driving the frames
+//---------------------------------------------------------------------------------------
+class FrameTelemetry
+{
+public:
+    enum Section { eEMULATION, eSCREEN_CONVERSION, eTEXTURE_UPLOAD, eGUI_DRAW, eAUDIO, eBACKGROUND, eNUM_SECTIONS };
+    static constexpr size_t HISTORY_SIZE = 512;
+    using Clock = std::chrono::steady_clock;
+    struct Frame
+    {
+        int64_t start_us{0};        // frame start relative to the first frame
+        uint32_t duration_us{0};    // time from this frame start to the next one
+        uint32_t emulationFrames{0};
+        uint32_t audioFill{0};      // samples queued in the audio ring at frame end
+        uint32_t audioUnderruns{0}; // underruns that happened during this frame
+        std::array<uint32_t, eNUM_SECTIONS> section_us{};
+    };
+
+    // Times the enclosing scope into the given section, scopes nested on the same thread
+    // are taken out of the outer one, so the sections of a frame never overlap
+    class Scope
+    {
+    public:
+        Scope(FrameTelemetry& telemetry, Section section)
+            : _telemetry(telemetry)
+            , _section(section)
+            , _outer(_current)
+            , _start(Clock::now())
+        {
+            _current = this;
+        }
+        ~Scope()
+        {
+            auto duration = Clock::now() - _start;
+            _telemetry.add(_section, duration);
+            if(_outer)
+                _outer->_telemetry.add(_outer->_section, -duration);
+            _current = _outer;
+        }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+    private:
+        static inline thread_local Scope* _current{nullptr};
+        FrameTelemetry& _telemetry;
+        Section _section;
+        Scope* _outer;
+        Clock::time_point _start;
+    };
+
+    static const char* sectionName(Section section)
+    {
+        static const char* names[eNUM_SECTIONS] = {"emulation", "screen_conversion", "texture_upload", "gui_draw", "audio", "background"};
+        return names[section];
+    }
+
+    void reset()
+    {
+        _size = _next = 0;
+        _frameOpen = false;
+        for(auto& acc : _accumulated)
+            acc = 0;
+        _emulationFrames = 0;
+    }
+
+    void add(Section section, Clock::duration duration)
+    {
+        _accumulated[section].fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count(), std::memory_order_relaxed);
+    }
+
+    void addEmulationFrames(uint32_t frames)
+    {
+        _emulationFrames.fetch_add(frames, std::memory_order_relaxed);
+    }
+
+    // Starts a frame, the previous one gets its duration from the time between both starts
+    void beginFrame()
+    {
+        auto now = Clock::now();
+        if(!_size && !_frameOpen)
+            _epoch = now;
+        if(_frameOpen)
+            endFrame();
+        if(_size) {
+            auto& last = _history[(_next + HISTORY_SIZE - 1) % HISTORY_SIZE];
+            last.duration_us = uint32_t(std::chrono::duration_cast<std::chrono::microseconds>(now - _epoch).count() - last.start_us);
+        }
+        _frameStart = now;
+        _frameOpen = true;
+    }
+
+    // Closes the current frame and moves the accumulated section times into the history
+    void endFrame(size_t audioFill = 0, uint64_t audioUnderruns = 0)
+    {
+        if(!_frameOpen)
+            return;
+        auto& frame = _history[_next];
+        frame.start_us = std::chrono::duration_cast<std::chrono::microseconds>(_frameStart - _epoch).count();
+        frame.duration_us = uint32_t(std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - _frameStart).count());
+        for(int i = 0; i < eNUM_SECTIONS; ++i)
+            frame.section_us[i] = uint32_t(std::max(int64_t(0), _accumulated[i].exchange(0, std::memory_order_relaxed) + 500) / 1000);
+        frame.emulationFrames = _emulationFrames.exchange(0, std::memory_order_relaxed);
+        frame.audioFill = uint32_t(audioFill);
+        frame.audioUnderruns = uint32_t(audioUnderruns - std::min(audioUnderruns, _lastUnderruns));
+        _lastUnderruns = audioUnderruns;
+        _next = (_next + 1) % HISTORY_SIZE;
+        _size = std::min(_size + 1, HISTORY_SIZE);
+        _frameOpen = false;
+    }
+
+    size_t size() const { return _size; }
+
+    // Frames in chronological order, index 0 is the oldest one still in the ring
+    const Frame& operator[](size_t index) const { return _history[(_next + HISTORY_SIZE - _size + index) % HISTORY_SIZE]; }
+
+    void exportCSV(std::ostream& os) const
+    {
+        os << "frame,start_us,duration_us,emulation_frames";
+        for(int i = 0; i < eNUM_SECTIONS; ++i)
+            os << ',' << sectionName(Section(i)) << "_us";
+        os << ",audio_fill,audio_underruns\n";
+        for(size_t i = 0; i < _size; ++i) {
+            const auto& frame = (*this)[i];
+            os << i << ',' << frame.start_us << ',' << frame.duration_us << ',' << frame.emulationFrames;
+            for(auto us : frame.section_us)
+                os << ',' << us;
+            os << ',' << frame.audioFill << ',' << frame.audioUnderruns << '\n';
+        }
+    }
+
+    void exportJSON(std::ostream& os) const
+    {
+        auto frames = nlohmann::ordered_json::array();
+        for(size_t i = 0; i < _size; ++i) {
+            const auto& frame = (*this)[i];
+            nlohmann::ordered_json entry = {{"start_us", frame.start_us}, {"duration_us", frame.duration_us}, {"emulation_frames", frame.emulationFrames}};
+            for(int s = 0; s < eNUM_SECTIONS; ++s)
+                entry[std::string(sectionName(Section(s))) + "_us"] = frame.section_us[s];
+            entry["audio_fill"] = frame.audioFill;
+            entry["audio_underruns"] = frame.audioUnderruns;
+            frames.push_back(std::move(entry));
+        }
+        os << nlohmann::ordered_json{{"frames", frames}}.dump(2) << std::endl;
+    }
+
+    // Writes JSON if the filename ends in `.json`, CSV otherwise
+    bool exportToFile(const std::string& filename) const
+    {
+        std::ofstream os(filename);
+        if(!os)
+            return false;
+        if(filename.size() >= 5 && filename.compare(filename.size() - 5, 5, ".json") == 0)
+            exportJSON(os);
+        else
+            exportCSV(os);
+        return bool(os);
+    }
+
+private:
+    std::array<Frame, HISTORY_SIZE> _history{};
+    size_t _size{0};
+    size_t _next{0};
+    bool _frameOpen{false};
+    Clock::time_point _epoch{};
+    Clock::time_point _frameStart{};
+    uint64_t _lastUnderruns{0};
+    std::array<std::atomic<int64_t>, eNUM_SECTIONS> _accumulated{};  // nanoseconds, nested scopes subtract
+    std::atomic<uint32_t> _emulationFrames{0};
+};
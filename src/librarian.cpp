@@ -24,16 +24,20 @@
 //
 //---------------------------------------------------------------------------------------
 #include <emulation/chip8cores.hpp>
+#include <emulation/mappedfile.hpp>
 #include <chiplet/chip8decompiler.hpp>
 #include <chiplet/utility.hpp>
 #include <librarian.hpp>
 #include <chip8emuhostex.hpp>
 
+#include <fmt/format.h>
 #include <nlohmann/json.hpp>
 #include <raylib.h>
 
 #include <algorithm>
+#include <array>
 #include <chrono>
+#include <thread>
 
 static std::unique_ptr<emu::IChip8Emulator> minion;
 
@@ -776,7 +780,37 @@ static KnownRomInfo g_knownRoms[] = {
 
 };
 
-static constexpr int g_knownRomNum = sizeof(g_knownRoms) / sizeof(g_knownRoms[0]);
+static constexpr size_t g_knownRomNum = sizeof(g_knownRoms) / sizeof(g_knownRoms[0]);
+static_assert(g_knownRomNum < 65536, "known rom index uses 16 bit entries");
+
+//---------------------------------------------------------------------------------------
+// Binary index of the known ROMs, sorted by digest, so lookups are a binary search over
+// 20 byte values instead of string compares over the whole table. It is built once on
+// first use, the table itself stays in its order, as it is also accessed by index.
+//---------------------------------------------------------------------------------------
+struct KnownRomIndex
+{
+    std::array<Sha1Digest, g_knownRomNum> digests{};
+    std::array<uint16_t, g_knownRomNum> entries{};
+};
+
+static const KnownRomIndex& knownRomIndex()
+{
+    static const KnownRomIndex index = []() {
+        KnownRomIndex result;
+        std::array<std::pair<Sha1Digest, uint16_t>, g_knownRomNum> sorted;
+        for(size_t i = 0; i < g_knownRomNum; ++i) {
+            sorted[i] = {Sha1Digest::fromHex(g_knownRoms[i].sha1), uint16_t(i)};
+        }
+        std::sort(sorted.begin(), sorted.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+        for(size_t i = 0; i < g_knownRomNum; ++i) {
+            result.digests[i] = sorted[i].first;
+            result.entries[i] = sorted[i].second;
+        }
+        return result;
+    }();
+    return index;
+}
 
 size_t Librarian::numKnownRoms()
 {
@@ -793,16 +827,22 @@ const KnownRomInfo* Librarian::getKnownRoms()
     return g_knownRoms;
 }
 
-const KnownRomInfo* Librarian::findKnownRom(const std::string sha1)
+const KnownRomInfo* Librarian::findKnownRom(const Sha1Digest& digest)
 {
-    for(int i = 0; i < g_knownRomNum; ++i) {
-        if(sha1 == g_knownRoms[i].sha1) {
-            return &g_knownRoms[i];
-        }
+    const auto& index = knownRomIndex();
+    auto iter = std::lower_bound(index.digests.begin(), index.digests.end(), digest);
+    if(iter != index.digests.end() && *iter == digest) {
+        return &g_knownRoms[index.entries[iter - index.digests.begin()]];
     }
     return nullptr;
 }
 
+const KnownRomInfo* Librarian::findKnownRom(std::string_view sha1)
+{
+    auto digest = Sha1Digest::fromHex(sha1);
+    return digest.isZero() ? nullptr : findKnownRom(digest);
+}
+
 std::string Librarian::Info::minimumOpcodeProfile() const
 {
     auto mask = static_cast<uint64_t>(possibleVariants);
@@ -831,10 +871,30 @@ emu::Chip8EmulatorOptions::SupportedPreset Librarian::Info::minimumOpcodePreset(
 Librarian::Librarian(const CadmiumConfiguration& cfg)
 : _cfg(cfg)
 {
-    static bool once = false;
-    if(!once) {
-        once = true;
-        TraceLog(LOG_INFO, "Internal database contains `%d` different program checksums.", g_knownRomNum);
+    // headless hosts create librarians on background threads too
+    static std::once_flag once;
+    std::call_once(once, []() { TraceLog(LOG_INFO, "Internal database contains `%d` different program checksums.", g_knownRomNum); });
+}
+
+Librarian::~Librarian()
+{
+    {
+        std::lock_guard<std::mutex> lock(_thumbnailMutex);
+        _thumbnailShutdown = true;
+    }
+    _thumbnailCondition.notify_all();
+    if(_thumbnailThread.joinable())
+        _thumbnailThread.join();
+    cancelAnalysis();
+    if(_cacheDirty)
+        saveCache();
+    {
+        std::lock_guard<std::mutex> lock(_workerMutex);
+        _shutdown = true;
+    }
+    _workerCondition.notify_all();
+    for(auto& worker : _workers) {
+        worker.join();
     }
 }
 
@@ -843,63 +903,149 @@ std::string Librarian::fullPath(std::string file) const
     return (fs::path(_currentPath) / file).string();
 }
 
+static Librarian::Info infoFromEntry(const std::string& name, const DirectoryWatcher::Entry& entry)
+{
+    auto changeDate = convertClock(fs::file_time_type(fs::file_time_type::duration(entry.time)));
+    if(entry.isDirectory) {
+        return {name, Librarian::Info::eDIRECTORY, emu::Chip8EmulatorOptions::eCHIP8, 0, changeDate};
+    }
+    auto ext = fs::path(name).extension();
+    auto type = Librarian::Info::eUNKNOWN_FILE;
+    auto variant = emu::Chip8EmulatorOptions::eCHIP8;
+    if(ext == ".8o") type = Librarian::Info::eOCTO_SOURCE;
+    else if(ext == ".ch8")
+        type = Librarian::Info::eROM_FILE;
+    else if(ext == ".ch10")
+        type = Librarian::Info::eROM_FILE, variant = emu::Chip8EmulatorOptions::eCHIP10;
+    else if(ext == ".hc8")
+        type = Librarian::Info::eROM_FILE, variant = emu::Chip8EmulatorOptions::eCHIP8VIP;
+    else if(ext == ".c8h")
+        type = Librarian::Info::eROM_FILE, variant = emu::Chip8EmulatorOptions::eCHIP8VIP_TPD;
+    else if(ext == ".c8e")
+        type = Librarian::Info::eROM_FILE, variant = emu::Chip8EmulatorOptions::eCHIP8EVIP;
+    else if(ext == ".c8x")
+        type = Librarian::Info::eROM_FILE, variant = emu::Chip8EmulatorOptions::eCHIP8XVIP;
+    else if(ext == ".sc8")
+        type = Librarian::Info::eROM_FILE, variant = emu::Chip8EmulatorOptions::eSCHIP11;
+    else if(ext == ".mc8")
+        type = Librarian::Info::eROM_FILE, variant = emu::Chip8EmulatorOptions::eMEGACHIP;
+    else if(ext == ".xo8")
+        type = Librarian::Info::eROM_FILE, variant = emu::Chip8EmulatorOptions::eXOCHIP;
+    else if(ext == ".c8b")
+        type = Librarian::Info::eROM_FILE;
+    else if(ext == ".bin" || ext == ".ram")
+        type = Librarian::Info::eROM_FILE, variant = emu::Chip8EmulatorOptions::eRAWVIP;
+    return {name, type, variant, (size_t)entry.size, changeDate};
+}
+
+static Librarian::Info infoFromEntry(const fs::directory_entry& de)
+{
+    DirectoryWatcher::Entry entry;
+    entry.isDirectory = de.is_directory();
+    entry.size = entry.isDirectory ? 0 : uint64_t(de.file_size());
+    entry.time = int64_t(de.last_write_time().time_since_epoch().count());
+    return infoFromEntry(de.path().filename().string(), entry);
+}
+
+static bool entryOrder(const Librarian::Info& a, const Librarian::Info& b)
+{
+    if(a.type == Librarian::Info::eDIRECTORY && b.type != Librarian::Info::eDIRECTORY) {
+        return true;
+    }
+    else if(a.type != Librarian::Info::eDIRECTORY && b.type == Librarian::Info::eDIRECTORY) {
+        return false;
+    }
+    return a.filePath < b.filePath;
+}
+
+// Entries are sorted by entryOrder, a name is looked up as directory and as file, as
+// it might have changed its type since it was listed
+static std::vector<Librarian::Info>::iterator findEntry(std::vector<Librarian::Info>& entries, const std::string& name)
+{
+    for(auto type : {Librarian::Info::eDIRECTORY, Librarian::Info::eUNKNOWN_FILE}) {
+        Librarian::Info key{name, type, emu::Chip8EmulatorOptions::eCHIP8, 0, {}};
+        auto iter = std::lower_bound(entries.begin(), entries.end(), key, entryOrder);
+        if(iter != entries.end() && iter->filePath == name && (iter->type == Librarian::Info::eDIRECTORY) == (type == Librarian::Info::eDIRECTORY))
+            return iter;
+    }
+    return entries.end();
+}
+
 bool Librarian::fetchDir(std::string directory)
 {
     std::error_code ec;
-    _currentPath = fs::canonical(directory, ec).string();
+    auto path = fs::canonical(directory, ec).string();
+    // the watched directory is kept up to date by update(), so it is not listed again
+    if(!ec && path == _currentPath && _watcher.isWatching() && _watcher.directory() == path)
+        return true;
+    _currentPath = path;
+    _watcher.stop();
+    cancelAnalysis();
+    {
+        // pending thumbnails of the previous directory are not needed anymore
+        std::lock_guard<std::mutex> lock(_thumbnailMutex);
+        _thumbnailQueue.clear();
+    }
+    _lastPrefetch = {};
     _directoryEntries.clear();
     _activeEntry = -1;
     _analyzing = true;
-    try {
-        _directoryEntries.push_back({"..", Info::eDIRECTORY, emu::Chip8EmulatorOptions::eCHIP8, 0, {}});
-        for(auto& de : fs::directory_iterator(directory)) {
-            if(de.is_directory()) {
-                _directoryEntries.push_back({de.path().filename().string(), Info::eDIRECTORY, emu::Chip8EmulatorOptions::eCHIP8, 0, convertClock(de.last_write_time())});
-            }
-            else if(de.is_regular_file()) {
-                auto ext = de.path().extension();
-                auto type = Info::eUNKNOWN_FILE;
-                auto variant = emu::Chip8EmulatorOptions::eCHIP8;
-                if(ext == ".8o") type = Info::eOCTO_SOURCE;
-                else if(ext == ".ch8")
-                    type = Info::eROM_FILE;
-                else if(ext == ".ch10")
-                    type = Info::eROM_FILE, variant = emu::Chip8EmulatorOptions::eCHIP10;
-                else if(ext == ".hc8")
-                    type = Info::eROM_FILE, variant = emu::Chip8EmulatorOptions::eCHIP8VIP;
-                else if(ext == ".c8h")
-                    type = Info::eROM_FILE, variant = emu::Chip8EmulatorOptions::eCHIP8VIP_TPD;
-                else if(ext == ".c8e")
-                    type = Info::eROM_FILE, variant = emu::Chip8EmulatorOptions::eCHIP8EVIP;
-                else if(ext == ".c8x")
-                    type = Info::eROM_FILE, variant = emu::Chip8EmulatorOptions::eCHIP8XVIP;
-                else if(ext == ".sc8")
-                    type = Info::eROM_FILE, variant = emu::Chip8EmulatorOptions::eSCHIP11;
-                else if(ext == ".mc8")
-                    type = Info::eROM_FILE, variant = emu::Chip8EmulatorOptions::eMEGACHIP;
-                else if(ext == ".xo8")
-                    type = Info::eROM_FILE, variant = emu::Chip8EmulatorOptions::eXOCHIP;
-                else if(ext == ".c8b")
-                    type = Info::eROM_FILE;
-                else if(ext == ".bin" || ext == ".ram")
-                    type = Info::eROM_FILE, variant = emu::Chip8EmulatorOptions::eRAWVIP;
-                _directoryEntries.push_back({de.path().filename().string(), type, variant, (size_t)de.file_size(), convertClock(de.last_write_time())});
-            }
-        }
-        std::sort(_directoryEntries.begin(), _directoryEntries.end(), [](const Info& a, const Info& b){
-           if(a.type == Info::eDIRECTORY && b.type != Info::eDIRECTORY) {
-               return true;
-           }
-           else if(a.type != Info::eDIRECTORY && b.type == Info::eDIRECTORY) {
-               return false;
-           }
-           return a.filePath < b.filePath;
-        });
+    _numAnalyzed = 0;
+    // the entries come from the baseline of the watcher, so nothing changes unnoticed between two listings
+    if(ec || !_watcher.watch(_currentPath))
+        return false;
+    _directoryEntries.reserve(_watcher.entries().size() + 1);
+    _directoryEntries.push_back({"..", Info::eDIRECTORY, emu::Chip8EmulatorOptions::eCHIP8, 0, {}});
+    for(const auto& [name, entry] : _watcher.entries()) {
+        _directoryEntries.push_back(infoFromEntry(name, entry));
     }
-    catch(fs::filesystem_error& fe)
-    {
+    std::sort(_directoryEntries.begin(), _directoryEntries.end(), entryOrder);
+#ifdef __EMSCRIPTEN__
+    // nothing changes the virtual filesystem behind our back, so it is not polled
+    _watcher.stop();
+#endif
+    return true;
+}
+
+// Applies the changes of the watched directory to the entries, added and modified files
+// start unanalyzed and get picked up by a new batch, so only they are analyzed again
+bool Librarian::applyDirectoryChanges()
+{
+    auto events = _watcher.poll();
+    if(events.empty())
         return false;
+    // results of a running batch refer to entry indices, it is restarted after the changes
+    cancelAnalysis();
+    for(const auto& event : events) {
+        auto iter = findEntry(_directoryEntries, event.name);
+        if(iter != _directoryEntries.end()) {
+            auto index = int(iter - _directoryEntries.begin());
+            if(iter->analyzed)
+                --_numAnalyzed;
+            _directoryEntries.erase(iter);
+            if(_activeEntry == index)
+                _activeEntry = -1;
+            else if(_activeEntry > index)
+                --_activeEntry;
+        }
+        if(event.change == DirectoryWatcher::eREMOVED)
+            continue;
+        std::error_code ec;
+        fs::directory_entry de(fs::path(_currentPath) / event.name, ec);
+        if(ec || !(de.is_directory(ec) || de.is_regular_file(ec)))
+            continue;
+        try {
+            auto info = infoFromEntry(de);
+            auto pos = std::upper_bound(_directoryEntries.begin(), _directoryEntries.end(), info, entryOrder);
+            if(_activeEntry >= int(pos - _directoryEntries.begin()))
+                ++_activeEntry;
+            _directoryEntries.insert(pos, std::move(info));
+        }
+        catch(fs::filesystem_error& fe)
+        {
+        }
     }
+    _analyzing = true;
     return true;
 }
 
@@ -913,70 +1059,364 @@ bool Librarian::parentDir()
     return fetchDir(fs::path(_currentPath).parent_path().string());
 }
 
+//---------------------------------------------------------------------------------------
+// ROM analysis: loading, hashing and decompiling the entries of a directory runs on a
+// small pool of worker threads. Workers claim groups of jobs through an atomic counter,
+// hash the files of a group side by side with the multi-buffer SHA1 and report
+// finished ones through a lock-free queue, that update() drains on the UI thread, so
+// entries get published progressively and only the UI thread touches them. Changing
+// the directory cancels the batch, workers drop it after their current job.
+//---------------------------------------------------------------------------------------
+struct Librarian::AnalysisBatch
+{
+    static constexpr size_t JOB_GROUP = 4;  // jobs claimed at once, hashed as one multi-buffer run
+    struct Job
+    {
+        size_t entry;
+        std::string path;
+        bool decompile;
+        uint16_t startAddress;
+        uint64_t fileSize;
+        int64_t fileTime;
+    };
+    emu::Chip8EmulatorOptions::SupportedPreset preset;
+    emu::Chip8Variant presetVariant;
+    std::vector<Job> jobs;
+    std::vector<AnalysisResult> results;
+    std::unique_ptr<std::atomic<int64_t>[]> finished;  // job numbers in order of completion, -1 until written
+    std::atomic<size_t> nextJob{0};
+    std::atomic<size_t> finishedWrite{0};
+    size_t finishedRead{0};
+    std::atomic_bool cancelled{false};
+};
+
+void Librarian::startAnalysis(const emu::Chip8EmulatorOptions& options)
+{
+    if(!_cacheLoaded)
+        loadCache();
+    auto batch = std::make_shared<AnalysisBatch>();
+    batch->preset = options.behaviorBase;
+    batch->presetVariant = options.presetAsVariant();
+    for(size_t i = 0; i < _directoryEntries.size(); ++i) {
+        auto& entry = _directoryEntries[i];
+        if(entry.analyzed)
+            continue;
+        if(entry.type == Info::eROM_FILE && entry.fileSize < 1024 * 1024 * 16) {
+            uint16_t startAddress = endsWith(entry.filePath, ".c8x") ? 0x300 : 0x200;
+            bool decompile = entry.variant == emu::Chip8EmulatorOptions::eCHIP8;
+            auto path = (fs::path(_currentPath) / entry.filePath).string();
+            std::error_code ec;
+            auto fileTime = int64_t(fs::last_write_time(path, ec).time_since_epoch().count());
+            auto cacheIter = _cache.find(path);
+            if(!ec && cacheIter != _cache.end() && cacheIter->second.fileSize == entry.fileSize && cacheIter->second.fileTime == fileTime) {
+                auto result = cacheIter->second.result;
+                if(cacheIter->second.preset != batch->preset)
+                    result.estimatedPreset = estimatePreset(result.possibleVariants, batch->preset, batch->presetVariant);
+                publishResult(entry, decompile, result);
+                continue;
+            }
+            batch->jobs.push_back({i, path, decompile, startAddress, entry.fileSize, ec ? 0 : fileTime});
+        }
+        else {
+            entry.analyzed = true;
+            ++_numAnalyzed;
+        }
+    }
+    batch->results.resize(batch->jobs.size());
+    batch->finished = std::make_unique<std::atomic<int64_t>[]>(batch->jobs.size());
+    for(size_t i = 0; i < batch->jobs.size(); ++i) {
+        batch->finished[i].store(-1, std::memory_order_relaxed);
+    }
+#ifndef __EMSCRIPTEN__
+    if(_workers.empty() && !batch->jobs.empty()) {
+        auto numWorkers = std::clamp(int(std::thread::hardware_concurrency()) - 1, 1, 4);
+        for(int i = 0; i < numWorkers; ++i) {
+            _workers.emplace_back(&Librarian::analysisWorker, this);
+        }
+    }
+#endif
+    {
+        std::lock_guard<std::mutex> lock(_workerMutex);
+        _batch = std::move(batch);
+    }
+    _workerCondition.notify_all();
+}
+
+void Librarian::cancelAnalysis()
+{
+    std::lock_guard<std::mutex> lock(_workerMutex);
+    if(_batch) {
+        _batch->cancelled = true;
+        _batch.reset();
+    }
+}
+
+void Librarian::analysisWorker()
+{
+    while(true) {
+        std::shared_ptr<AnalysisBatch> batch;
+        {
+            std::unique_lock<std::mutex> lock(_workerMutex);
+            _workerCondition.wait(lock, [this]() { return _shutdown || (_batch && _batch->nextJob.load() < _batch->jobs.size()); });
+            if(_shutdown)
+                return;
+            batch = _batch;
+        }
+        while(!batch->cancelled) {
+            auto job = batch->nextJob.fetch_add(AnalysisBatch::JOB_GROUP);
+            if(job >= batch->jobs.size())
+                break;
+            analyzeJobs(*batch, job, std::min(AnalysisBatch::JOB_GROUP, batch->jobs.size() - job));
+        }
+    }
+}
+
+emu::Chip8EmulatorOptions::SupportedPreset Librarian::estimatePreset(emu::Chip8Variant possibleVariants, emu::Chip8EmulatorOptions::SupportedPreset preset, emu::Chip8Variant presetVariant)
+{
+    auto supports = [possibleVariants](emu::Chip8Variant variant) { return ((uint64_t)possibleVariants & (uint64_t)variant) != 0; };
+    if (supports(presetVariant))
+        return preset;
+    else if (supports(emu::Chip8Variant::XO_CHIP))
+        return emu::Chip8EmulatorOptions::eXOCHIP;
+    else if (supports(emu::Chip8Variant::MEGA_CHIP))
+        return emu::Chip8EmulatorOptions::eMEGACHIP;
+    else if (supports(emu::Chip8Variant::SCHIP_1_1))
+        return emu::Chip8EmulatorOptions::eSCHIP11;
+    else if (supports(emu::Chip8Variant::SCHIP_1_0))
+        return emu::Chip8EmulatorOptions::eSCHIP10;
+    else if (supports(emu::Chip8Variant::CHIP_48))
+        return emu::Chip8EmulatorOptions::eCHIP48;
+    else if (supports(emu::Chip8Variant::CHIP_10))
+        return emu::Chip8EmulatorOptions::eSCHIP10;
+    return emu::Chip8EmulatorOptions::eCHIP8;
+}
+
+// Runs on a worker, so it only uses the jobs and the static ROM table, never the entries
+// or the configuration, those are checked by update() when the result gets published.
+// Files are read buffered, a watched ROM being truncated while mapped would raise SIGBUS.
+void Librarian::analyzeJobs(AnalysisBatch& batch, size_t first, size_t count)
+{
+    std::array<emu::MappedFile, AnalysisBatch::JOB_GROUP> files;
+    std::array<emu::Sha1Hasher::Input, AnalysisBatch::JOB_GROUP> inputs;
+    std::array<emu::Sha1Hasher::State, AnalysisBatch::JOB_GROUP> digests;
+    for(size_t i = 0; i < count; ++i) {
+        files[i] = emu::MappedFile(batch.jobs[first + i].path, MAX_ROM_SIZE, emu::MappedFile::eBUFFERED);
+        inputs[i] = {files[i].data(), files[i].size()};
+    }
+    emu::Sha1Hasher::hashMany(inputs.data(), count, digests.data());
+    for(size_t i = 0; i < count; ++i) {
+        auto job = first + i;
+        const auto& jobInfo = batch.jobs[job];
+        const auto& file = files[i];
+        auto& result = batch.results[job];
+        result.digest = {digests[i]};
+        result.inKnownRoms = findKnownRom(result.digest) != nullptr;
+        if(jobInfo.decompile && !result.inKnownRoms) {
+            emu::Chip8Decompiler dec;
+            dec.decompile(jobInfo.path, file.data(), jobInfo.startAddress, file.size(), jobInfo.startAddress, nullptr, true, true);
+            result.possibleVariants = dec.possibleVariants();
+            if ((uint64_t)dec.possibleVariants())
+                result.estimatedPreset = estimatePreset(result.possibleVariants, batch.preset, batch.presetVariant);
+        }
+        auto slot = batch.finishedWrite.fetch_add(1, std::memory_order_relaxed);
+        batch.finished[slot].store(int64_t(job), std::memory_order_release);
+    }
+}
+
+void Librarian::publishResult(Info& entry, bool decompiled, const AnalysisResult& result)
+{
+    entry.isKnown = isKnownFile(result.digest);
+    entry.sha1sum = result.digest.toHex();
+    if(!decompiled || entry.isKnown) {
+        entry.variant = getPresetForFile(result.digest);
+    }
+    else {
+        entry.possibleVariants = result.possibleVariants;
+        if((uint64_t)result.possibleVariants)
+            entry.variant = result.estimatedPreset;
+        else
+            entry.type = Info::eUNKNOWN_FILE;
+        TraceLog(LOG_DEBUG, "analyzed `%s`: %s", entry.filePath.c_str(), emu::Chip8EmulatorOptions::nameOfPreset(entry.variant).c_str());
+    }
+    entry.analyzed = true;
+    ++_numAnalyzed;
+}
+
 bool Librarian::update(const emu::Chip8EmulatorOptions& options)
 {
-    bool foundOne = false;
+    bool foundOne = applyDirectoryChanges();
     if(_analyzing) {
-        for (auto& entry : _directoryEntries) {
-            if (!entry.analyzed) {
-                foundOne = true;
-                if(entry.type == Info::eROM_FILE && entry.fileSize < 1024 * 1024 * 16) {
-                    if (entry.variant == emu::Chip8EmulatorOptions::eCHIP8) {
-                        auto file = loadFile((fs::path(_currentPath) / entry.filePath).string());
-                        entry.isKnown = isKnownFile(file.data(), file.size());
-                        entry.sha1sum = calculateSha1(file.data(), file.size()).to_hex();
-                        if(entry.isKnown) {
-                            entry.variant = getPresetForFile(entry.sha1sum);
-                        }
-                        else {
-                            emu::Chip8Decompiler dec;
-                            uint16_t startAddress = endsWith(entry.filePath, ".c8x") ? 0x300 : 0x200;
-                            dec.decompile(entry.filePath, file.data(), startAddress, file.size(), startAddress, nullptr, true, true);
-                            entry.possibleVariants = dec.possibleVariants();
-                            if ((uint64_t)dec.possibleVariants()) {
-                                if (dec.supportsVariant(options.presetAsVariant()))
-                                    entry.variant = options.behaviorBase;
-                                else if (dec.supportsVariant(emu::Chip8Variant::XO_CHIP))
-                                    entry.variant = emu::Chip8EmulatorOptions::eXOCHIP;
-                                else if (dec.supportsVariant(emu::Chip8Variant::MEGA_CHIP))
-                                    entry.variant = emu::Chip8EmulatorOptions::eMEGACHIP;
-                                else if (dec.supportsVariant(emu::Chip8Variant::SCHIP_1_1))
-                                    entry.variant = emu::Chip8EmulatorOptions::eSCHIP11;
-                                else if (dec.supportsVariant(emu::Chip8Variant::SCHIP_1_0))
-                                    entry.variant = emu::Chip8EmulatorOptions::eSCHIP10;
-                                else if (dec.supportsVariant(emu::Chip8Variant::CHIP_48))
-                                    entry.variant = emu::Chip8EmulatorOptions::eCHIP48;
-                                else if (dec.supportsVariant(emu::Chip8Variant::CHIP_10))
-                                    entry.variant = emu::Chip8EmulatorOptions::eSCHIP10;
-                                else
-                                    entry.variant = emu::Chip8EmulatorOptions::eCHIP8;
-                            }
-                            else {
-                                entry.type = Info::eUNKNOWN_FILE;
-                            }
-                            TraceLog(LOG_DEBUG, "analyzed `%s`: %s", entry.filePath.c_str(), emu::Chip8EmulatorOptions::nameOfPreset(entry.variant).c_str());
-                        }
-                    }
-                    else {
-                        auto file = loadFile((fs::path(_currentPath) / entry.filePath).string());
-                        entry.isKnown = isKnownFile(file.data(), file.size());
-                        entry.sha1sum = calculateSha1(file.data(), file.size()).to_hex();
-                        entry.variant = getPresetForFile(entry.sha1sum);
-                    }
-                }
-                entry.analyzed = true;
+        if(!_batch)
+            startAnalysis(options);
+        auto& batch = *_batch;
+#ifdef __EMSCRIPTEN__
+        // no worker threads here, so some of the jobs are done on every update
+        auto until = std::chrono::steady_clock::now() + std::chrono::milliseconds(8);
+        do {
+            auto job = batch.nextJob.fetch_add(AnalysisBatch::JOB_GROUP);
+            if(job >= batch.jobs.size())
+                break;
+            analyzeJobs(batch, job, std::min(AnalysisBatch::JOB_GROUP, batch.jobs.size() - job));
+        }
+        while(std::chrono::steady_clock::now() < until);
+#endif
+        while(batch.finishedRead < batch.jobs.size()) {
+            auto job = batch.finished[batch.finishedRead].load(std::memory_order_acquire);
+            if(job < 0)
+                break;
+            ++batch.finishedRead;
+            const auto& jobInfo = batch.jobs[job];
+            publishResult(_directoryEntries[jobInfo.entry], jobInfo.decompile, batch.results[job]);
+            if(jobInfo.fileTime) {
+                _cache[jobInfo.path] = {jobInfo.fileSize, jobInfo.fileTime, batch.preset, batch.results[job]};
+                _cacheDirty = true;
             }
+            foundOne = true;
         }
-        if (!foundOne)
+        if(batch.finishedRead == batch.jobs.size()) {
             _analyzing = false;
+            cancelAnalysis();
+            if(_cacheDirty)
+                saveCache();
+        }
     }
     return foundOne;
 }
 
-bool Librarian::isKnownFile(const uint8_t* data, size_t size) const
+//---------------------------------------------------------------------------------------
+// Analysis cache: a little endian binary file with a header naming the format, the
+// Cadmium version and the chiplet commit, a mismatch in any of them drops the whole
+// cache, as a new decompiler or ROM table can come to different results. Each entry is
+// keyed by the full path and only valid while size and modification time match.
+//---------------------------------------------------------------------------------------
+#ifndef CADMIUM_VERSION
+#define CADMIUM_VERSION "unknown"
+#endif
+#ifndef CHIPLET_COMMIT_HASH
+#define CHIPLET_COMMIT_HASH "unknown"
+#endif
+
+static constexpr uint32_t CACHE_MAGIC = 0x43413843;  // "C8AC"
+static constexpr uint32_t CACHE_FORMAT = 1;
+static const char* const CACHE_VERSION_KEY = CADMIUM_VERSION "/" CHIPLET_COMMIT_HASH;
+
+namespace {
+
+class CacheWriter
 {
-    auto sha1sum = calculateSha1(data, size).to_hex();
-    return _cfg.romConfigs.count(sha1sum) || findKnownRom(sha1sum) != nullptr;
+public:
+    void u8(uint8_t val) { _data.push_back(val); }
+    void u16(uint16_t val) { u8(val & 0xff); u8(val >> 8); }
+    void u32(uint32_t val) { u16(val & 0xffff); u16(val >> 16); }
+    void u64(uint64_t val) { u32(val & 0xffffffff); u32(val >> 32); }
+    void str(const std::string& val) { u16(uint16_t(val.size())); _data.insert(_data.end(), val.begin(), val.end()); }
+    void digest(const Sha1Digest& val)
+    {
+        for(auto word : val.words) {
+            u8(word >> 24); u8(word >> 16); u8(word >> 8); u8(word);
+        }
+    }
+    const std::vector<uint8_t>& data() const { return _data; }
+private:
+    std::vector<uint8_t> _data;
+};
+
+class CacheReader
+{
+public:
+    explicit CacheReader(const std::vector<uint8_t>& data) : _data(data) {}
+    bool ok() const { return _ok; }
+    uint8_t u8() { if(_pos >= _data.size()) { _ok = false; return 0; } return _data[_pos++]; }
+    uint16_t u16() { uint16_t lo = u8(); return lo | (uint16_t(u8()) << 8); }
+    uint32_t u32() { uint32_t lo = u16(); return lo | (uint32_t(u16()) << 16); }
+    uint64_t u64() { uint64_t lo = u32(); return lo | (uint64_t(u32()) << 32); }
+    std::string str()
+    {
+        auto size = u16();
+        if(_pos + size > _data.size()) { _ok = false; return {}; }
+        std::string result(_data.begin() + _pos, _data.begin() + _pos + size);
+        _pos += size;
+        return result;
+    }
+    Sha1Digest digest()
+    {
+        Sha1Digest result;
+        for(auto& word : result.words) {
+            for(int i = 0; i < 4; ++i)
+                word = (word << 8) | u8();
+        }
+        return result;
+    }
+private:
+    const std::vector<uint8_t>& _data;
+    size_t _pos{0};
+    bool _ok{true};
+};
+
+}
+
+void Librarian::loadCache()
+{
+    _cacheLoaded = true;
+    if(_cacheFile.empty())
+        return;
+    std::error_code ec;
+    if(!fs::exists(_cacheFile, ec))
+        return;
+    auto data = loadFile(_cacheFile);
+    CacheReader reader(data);
+    if(reader.u32() != CACHE_MAGIC || reader.u32() != CACHE_FORMAT || reader.str() != CACHE_VERSION_KEY || !reader.ok()) {
+        TraceLog(LOG_INFO, "Librarian cache `%s` is outdated and will be rebuilt", _cacheFile.c_str());
+        return;
+    }
+    auto count = reader.u32();
+    for(uint32_t i = 0; i < count && reader.ok(); ++i) {
+        auto path = reader.str();
+        CacheEntry entry;
+        entry.fileSize = reader.u64();
+        entry.fileTime = int64_t(reader.u64());
+        entry.result.digest = reader.digest();
+        entry.result.possibleVariants = static_cast<emu::Chip8Variant>(reader.u64());
+        entry.preset = static_cast<emu::Chip8EmulatorOptions::SupportedPreset>(reader.u8());
+        entry.result.estimatedPreset = static_cast<emu::Chip8EmulatorOptions::SupportedPreset>(reader.u8());
+        entry.result.inKnownRoms = reader.u8() != 0;
+        if(reader.ok())
+            _cache.emplace(std::move(path), std::move(entry));
+    }
+    TraceLog(LOG_INFO, "Librarian cache contains %d analyzed files", (int)_cache.size());
+}
+
+void Librarian::saveCache()
+{
+    _cacheDirty = false;
+    if(_cacheFile.empty())
+        return;
+    CacheWriter writer;
+    writer.u32(CACHE_MAGIC);
+    writer.u32(CACHE_FORMAT);
+    writer.str(CACHE_VERSION_KEY);
+    writer.u32(uint32_t(_cache.size()));
+    for(const auto& [path, entry] : _cache) {
+        writer.str(path);
+        writer.u64(entry.fileSize);
+        writer.u64(uint64_t(entry.fileTime));
+        writer.digest(entry.result.digest);
+        writer.u64(uint64_t(entry.result.possibleVariants));
+        writer.u8(uint8_t(entry.preset));
+        writer.u8(uint8_t(entry.result.estimatedPreset));
+        writer.u8(entry.result.inKnownRoms ? 1 : 0);
+    }
+    // written to a temporary first, so a crash never leaves a truncated cache behind
+    auto tempFile = _cacheFile + ".tmp";
+    if(writeFile(tempFile, (const char*)writer.data().data(), writer.data().size())) {
+        std::error_code ec;
+        fs::rename(tempFile, _cacheFile, ec);
+    }
+}
+
+bool Librarian::isKnownFile(const Sha1Digest& digest) const
+{
+    return findKnownRom(digest) != nullptr || _cfg.romConfigs.count(digest.toHex());
 }
 
 bool Librarian::isKnownFile(const std::string& sha1sum) const
@@ -984,19 +1424,18 @@ bool Librarian::isKnownFile(const std::string& sha1sum) const
     return _cfg.romConfigs.count(sha1sum) || findKnownRom(sha1sum) != nullptr;
 }
 
-emu::Chip8EmulatorOptions::SupportedPreset Librarian::getPresetForFile(std::string sha1sum) const
+emu::Chip8EmulatorOptions::SupportedPreset Librarian::getPresetForFile(const Sha1Digest& digest) const
 {
-    auto cfgIter = _cfg.romConfigs.find(sha1sum);
+    auto cfgIter = _cfg.romConfigs.find(digest.toHex());
     if(cfgIter != _cfg.romConfigs.end())
         return cfgIter->second.behaviorBase;
-    const auto* romInfo = findKnownRom(sha1sum);
+    const auto* romInfo = findKnownRom(digest);
     return romInfo ? emu::Chip8EmulatorOptions::presetForVariant(romInfo->variant) : emu::Chip8EmulatorOptions::eCHIP8;
 }
 
-emu::Chip8EmulatorOptions::SupportedPreset Librarian::getPresetForFile(const uint8_t* data, size_t size) const
+emu::Chip8EmulatorOptions::SupportedPreset Librarian::getPresetForFile(const std::string& sha1sum) const
 {
-    auto sha1sum = calculateSha1(data, size).to_hex();
-    return getPresetForFile(sha1sum);
+    return getPresetForFile(Sha1Digest::fromHex(sha1sum));
 }
 
 emu::Chip8EmulatorOptions::SupportedPreset Librarian::getEstimatedPresetForFile(emu::Chip8EmulatorOptions::SupportedPreset currentPreset, const uint8_t* data, size_t size) const
@@ -1025,19 +1464,18 @@ emu::Chip8EmulatorOptions::SupportedPreset Librarian::getEstimatedPresetForFile(
     return emu::Chip8EmulatorOptions::eCHIP8;
 }
 
-emu::Chip8EmulatorOptions Librarian::getOptionsForFile(const uint8_t* data, size_t size) const
+emu::Chip8EmulatorOptions Librarian::getOptionsForFile(const std::string& sha1sum) const
 {
-    auto sha1sum = calculateSha1(data, size).to_hex();
-    return getOptionsForFile(sha1sum);
+    return getOptionsForFile(Sha1Digest::fromHex(sha1sum));
 }
 
-emu::Chip8EmulatorOptions Librarian::getOptionsForFile(const std::string& sha1sum) const
+emu::Chip8EmulatorOptions Librarian::getOptionsForFile(const Sha1Digest& digest) const
 {
-    auto cfgIter = _cfg.romConfigs.find(sha1sum);
+    auto cfgIter = _cfg.romConfigs.find(digest.toHex());
     if(cfgIter != _cfg.romConfigs.end()) {
         return cfgIter->second;
     }
-    const auto* romInfo = findKnownRom(sha1sum);
+    const auto* romInfo = findKnownRom(digest);
     if (romInfo) {
         auto preset = emu::Chip8EmulatorOptions::presetForVariant(romInfo->variant);
         auto options = emu::Chip8EmulatorOptions::optionsOfPreset(preset);
@@ -1052,7 +1490,7 @@ emu::Chip8EmulatorOptions Librarian::getOptionsForFile(const std::string& sha1su
 
 emu::Chip8EmulatorOptions Librarian::getOptionsForSha1(const std::string_view& sha1)
 {
-    const auto* romInfo = findKnownRom(std::string(sha1));
+    const auto* romInfo = findKnownRom(sha1);
     if (romInfo) {
         auto preset = emu::Chip8EmulatorOptions::presetForVariant(romInfo->variant);
         auto options = emu::Chip8EmulatorOptions::optionsOfPreset(preset);
@@ -1067,57 +1505,50 @@ emu::Chip8EmulatorOptions Librarian::getOptionsForSha1(const std::string_view& s
 
 Librarian::Screenshot Librarian::genScreenshot(const Info& info, const std::array<uint32_t, 256> palette) const
 {
-    using namespace std::literals::chrono_literals;
     if(info.analyzed && (info.type == Info::eROM_FILE || info.type == Info::eOCTO_SOURCE) ) {
-        emu::Chip8HeadlessHost host;
-        host.updateEmulatorOptions({});
-        if(host.loadRom((fs::path(_currentPath) / info.filePath).string().c_str(), emu::Chip8HeadlessHost::SetToRun)) {
-            auto& chipEmu = host.chipEmu();
-            auto options = host.options();
-            auto ticks = 5000;
-            auto startChip8 = std::chrono::steady_clock::now();
-            auto colors = palette;
-            if(options.hasColors()) {
-                options.updateColors(colors);
-            }
-            int64_t lastCycles = -1;
-            int64_t cycles = 0;
-            int tickCount = 0;
-            for (tickCount = 0; tickCount < ticks /* && (cycles == chipEmu.getCycles()) != lastCycles */ && std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startChip8) < 100ms; ++tickCount) {
-                chipEmu.tick(options.instructionsPerFrame);
-                lastCycles = cycles;
-            }
-            auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startChip8).count();
-            TraceLog(LOG_WARNING, "executed %d cycles and %d frames in %dms for screenshot", (int)chipEmu.getCycles(), tickCount, (int)duration);
-            if (chipEmu.getScreen()) {
-                Screenshot s;
-                auto screen = *chipEmu.getScreen();
-                screen.setPalette(colors);
-                if (chipEmu.isDoublePixel()) {
-                    s.width = chipEmu.getCurrentScreenWidth() / 2;
-                    s.height = chipEmu.getCurrentScreenHeight() / 2;
-                    s.pixel.resize(s.width * s.height);
-                    for (int y = 0; y < chipEmu.getCurrentScreenHeight() / 2; ++y) {
-                        for (int x = 0; x < chipEmu.getCurrentScreenWidth() / 2; ++x) {
-                            s.pixel[y * s.width + x] = screen.getPixel(x*2, y*2);
-                        }
-                    }
-                }
-                else {
-                    s.width = chipEmu.getCurrentScreenWidth();
-                    s.height = chipEmu.getCurrentScreenHeight();
-                    s.pixel.resize(s.width * s.height);
-                    for (int y = 0; y < chipEmu.getCurrentScreenHeight(); ++y) {
-                        for (int x = 0; x < chipEmu.getCurrentScreenWidth(); ++x) {
-                            s.pixel[y * s.width + x] = screen.getPixel(x, y);
-                        }
+        return renderScreenshot((fs::path(_currentPath) / info.filePath).string(), palette);
+    }
+    return Librarian::Screenshot();
+}
+
+// Runs the ROM headless and grabs the screen, safe to call from any thread, as the
+// headless host neither touches the configuration nor raylib
+Librarian::Screenshot Librarian::renderScreenshot(const std::string& romPath, const std::array<uint32_t, 256>& palette, int maxFrames, std::chrono::milliseconds timeLimit)
+{
+    emu::Chip8HeadlessHost host;
+    host.updateEmulatorOptions({});
+    if(host.loadRom(romPath.c_str(), emu::Chip8HeadlessHost::SetToRun)) {
+        auto& chipEmu = host.chipEmu();
+        auto options = host.options();
+        auto startChip8 = std::chrono::steady_clock::now();
+        auto colors = palette;
+        if(options.hasColors()) {
+            options.updateColors(colors);
+        }
+        int64_t lastCycles = -1;
+        int64_t cycles = 0;
+        int tickCount = 0;
+        for (tickCount = 0; tickCount < maxFrames /* && (cycles == chipEmu.getCycles()) != lastCycles */ && (!timeLimit.count() || std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startChip8) < timeLimit); ++tickCount) {
+            chipEmu.tick(options.instructionsPerFrame);
+            lastCycles = cycles;
+        }
+        auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startChip8).count();
+        TraceLog(LOG_DEBUG, "executed %d cycles and %d frames in %dms for screenshot", (int)chipEmu.getCycles(), tickCount, (int)duration);
+        if (chipEmu.getScreen()) {
+            Screenshot s;
+            auto screen = *chipEmu.getScreen();
+            screen.setPalette(colors);
+            if (chipEmu.isDoublePixel()) {
+                s.width = chipEmu.getCurrentScreenWidth() / 2;
+                s.height = chipEmu.getCurrentScreenHeight() / 2;
+                s.pixel.resize(s.width * s.height);
+                for (int y = 0; y < chipEmu.getCurrentScreenHeight() / 2; ++y) {
+                    for (int x = 0; x < chipEmu.getCurrentScreenWidth() / 2; ++x) {
+                        s.pixel[y * s.width + x] = screen.getPixel(x*2, y*2);
                     }
                 }
-                return s;
             }
-            else if (chipEmu.getScreenRGBA()) {
-                Screenshot s;
-                auto screen = *chipEmu.getScreenRGBA();
+            else {
                 s.width = chipEmu.getCurrentScreenWidth();
                 s.height = chipEmu.getCurrentScreenHeight();
                 s.pixel.resize(s.width * s.height);
@@ -1126,13 +1557,251 @@ Librarian::Screenshot Librarian::genScreenshot(const Info& info, const std::arra
                         s.pixel[y * s.width + x] = screen.getPixel(x, y);
                     }
                 }
-                return s;
             }
+            return s;
+        }
+        else if (chipEmu.getScreenRGBA()) {
+            Screenshot s;
+            auto screen = *chipEmu.getScreenRGBA();
+            s.width = chipEmu.getCurrentScreenWidth();
+            s.height = chipEmu.getCurrentScreenHeight();
+            s.pixel.resize(s.width * s.height);
+            for (int y = 0; y < chipEmu.getCurrentScreenHeight(); ++y) {
+                for (int x = 0; x < chipEmu.getCurrentScreenWidth(); ++x) {
+                    s.pixel[y * s.width + x] = screen.getPixel(x, y);
+                }
+            }
+            return s;
         }
     }
     return Librarian::Screenshot();
 }
 
+//---------------------------------------------------------------------------------------
+// Thumbnail cache: previews are rendered by a background thread and stored as small
+// indexed color files in the thumbnail directory, named by SHA1, preset and a hash of
+// the palette, so browsing a folder again never needs the emulation. The format is a
+// little endian header (magic, format, width, height, number of colors), the colors as
+// RGBA and the pixel indices packed MSB first with 1, 2, 4 or 8 bits. Screens with
+// more than 256 colors are stored as raw RGBA with zero colors in the header.
+//---------------------------------------------------------------------------------------
+static constexpr uint32_t THUMBNAIL_MAGIC = 0x4E543843;  // "C8TN"
+static constexpr uint16_t THUMBNAIL_FORMAT = 1;
+static constexpr size_t MAX_THUMBNAILS_IN_MEMORY = 512;
+
+uint32_t Librarian::paletteHash(const std::array<uint32_t, 256>& palette)
+{
+    uint32_t hash = 0x811c9dc5;  // FNV-1a
+    for(auto color : palette) {
+        for(int i = 0; i < 4; ++i, color >>= 8) {
+            hash = (hash ^ (color & 0xff)) * 0x01000193;
+        }
+    }
+    return hash;
+}
+
+// Octo sources are not hashed by the analysis, in memory they are identified by path and
+// modification time, the worker hashes their content to name the persistent file
+Librarian::ThumbnailJob Librarian::thumbnailJob(const Info& info, const std::array<uint32_t, 256>& palette, uint32_t paletteHash) const
+{
+    ThumbnailJob job{{}, fullPath(info.filePath), palette, fmt::format("_{}_{:08x}", int(info.variant), paletteHash), !info.sha1sum.empty()};
+    if(job.hashed)
+        job.key = info.sha1sum + job.suffix;
+    else
+        job.key = fmt::format("{}@{}", job.path, info.changeDate.time_since_epoch().count()) + job.suffix;
+    return job;
+}
+
+std::optional<Librarian::Screenshot> Librarian::getThumbnail(const Info& info, const std::array<uint32_t, 256>& palette)
+{
+    if(!info.analyzed || (info.type != Info::eROM_FILE && info.type != Info::eOCTO_SOURCE))
+        return Screenshot();
+    auto job = thumbnailJob(info, palette, paletteHash(palette));
+    {
+        std::lock_guard<std::mutex> lock(_thumbnailMutex);
+        auto iter = _thumbnails.find(job.key);
+        if(iter != _thumbnails.end())
+            return iter->second;
+    }
+#ifdef __EMSCRIPTEN__
+    // no background thread here, so it is rendered right away
+    auto screenshot = genScreenshot(info, palette);
+    std::lock_guard<std::mutex> lock(_thumbnailMutex);
+    _thumbnails[job.key] = screenshot;
+    return screenshot;
+#else
+    queueThumbnail(std::move(job), true);
+    return std::nullopt;
+#endif
+}
+
+void Librarian::prefetchThumbnails(size_t first, size_t count, const std::array<uint32_t, 256>& palette)
+{
+#ifndef __EMSCRIPTEN__
+    auto hash = paletteHash(palette);
+    std::array<size_t, 4> prefetch = {first, count, _numAnalyzed, hash};
+    if(prefetch == _lastPrefetch)
+        return;
+    _lastPrefetch = prefetch;
+    for(size_t i = first; i < std::min(first + count, _directoryEntries.size()); ++i) {
+        const auto& info = _directoryEntries[i];
+        if(info.analyzed && (info.type == Info::eROM_FILE || info.type == Info::eOCTO_SOURCE))
+            queueThumbnail(thumbnailJob(info, palette, hash), false);
+    }
+#endif
+}
+
+// Urgent jobs (the selected entry) go to the front, others are only added if missing
+void Librarian::queueThumbnail(ThumbnailJob job, bool urgent)
+{
+    {
+        std::lock_guard<std::mutex> lock(_thumbnailMutex);
+        if(_thumbnails.count(job.key))
+            return;
+        auto iter = std::find_if(_thumbnailQueue.begin(), _thumbnailQueue.end(), [&job](const ThumbnailJob& queued) { return queued.key == job.key; });
+        if(iter != _thumbnailQueue.end()) {
+            if(!urgent || iter == _thumbnailQueue.begin())
+                return;
+            _thumbnailQueue.erase(iter);
+        }
+        if(urgent)
+            _thumbnailQueue.push_front(std::move(job));
+        else
+            _thumbnailQueue.push_back(std::move(job));
+        if(!_thumbnailThread.joinable())
+            _thumbnailThread = std::thread(&Librarian::thumbnailWorker, this);
+    }
+    _thumbnailCondition.notify_one();
+}
+
+void Librarian::thumbnailWorker()
+{
+    while(true) {
+        ThumbnailJob job;
+        {
+            std::unique_lock<std::mutex> lock(_thumbnailMutex);
+            _thumbnailCondition.wait(lock, [this]() { return _thumbnailShutdown || !_thumbnailQueue.empty(); });
+            if(_thumbnailShutdown)
+                return;
+            job = std::move(_thumbnailQueue.front());
+            _thumbnailQueue.pop_front();
+        }
+        auto fileKey = job.key;
+        if(!job.hashed) {
+            auto data = loadFile(job.path);
+            fileKey = data.empty() ? std::string() : Sha1Digest::calculate(data.data(), data.size()).toHex() + job.suffix;
+        }
+        Screenshot screenshot;
+        if(fileKey.empty() || !loadThumbnail(fileKey, screenshot)) {
+            // persisted thumbnails must not depend on the machine speed, so only frames count
+            screenshot = renderScreenshot(job.path, job.palette, 5000, std::chrono::milliseconds(0));
+            // a failed render (e.g. a file that is still being written) is only remembered
+            // in memory, so the next session retries it instead of serving an empty thumbnail
+            if(!fileKey.empty() && screenshot.width && screenshot.height)
+                saveThumbnail(fileKey, screenshot);
+        }
+        std::lock_guard<std::mutex> lock(_thumbnailMutex);
+        if(_thumbnails.size() >= MAX_THUMBNAILS_IN_MEMORY)
+            _thumbnails.clear();
+        _thumbnails.emplace(std::move(job.key), std::move(screenshot));
+    }
+}
+
+bool Librarian::loadThumbnail(const std::string& key, Screenshot& screenshot) const
+{
+    if(_thumbnailDirectory.empty())
+        return false;
+    std::error_code ec;
+    auto file = fs::path(_thumbnailDirectory) / (key + ".c8t");
+    if(!fs::exists(file, ec))
+        return false;
+    auto data = loadFile(file.string());
+    CacheReader reader(data);
+    if(reader.u32() != THUMBNAIL_MAGIC || reader.u16() != THUMBNAIL_FORMAT)
+        return false;
+    Screenshot result;
+    result.width = reader.u16();
+    result.height = reader.u16();
+    auto numColors = reader.u16();
+    if(!reader.ok() || !result.width || !result.height || numColors > 256)
+        return false;
+    result.pixel.resize(size_t(result.width) * result.height);
+    if(!numColors) {
+        for(auto& pixel : result.pixel)
+            pixel = reader.u32();
+    }
+    else {
+        std::vector<uint32_t> colors(numColors);
+        for(auto& color : colors)
+            color = reader.u32();
+        int bits = numColors <= 2 ? 1 : numColors <= 4 ? 2 : numColors <= 16 ? 4 : 8;
+        int shift = 0;
+        uint8_t byte = 0;
+        for(auto& pixel : result.pixel) {
+            if(!shift) {
+                byte = reader.u8();
+                shift = 8;
+            }
+            shift -= bits;
+            auto index = (byte >> shift) & ((1 << bits) - 1);
+            pixel = index < numColors ? colors[index] : 0;
+        }
+    }
+    if(!reader.ok())
+        return false;
+    screenshot = std::move(result);
+    return true;
+}
+
+void Librarian::saveThumbnail(const std::string& key, const Screenshot& screenshot) const
+{
+    if(_thumbnailDirectory.empty())
+        return;
+    std::vector<uint32_t> colors;
+    std::unordered_map<uint32_t, uint8_t> indices;
+    for(auto pixel : screenshot.pixel) {
+        if(indices.size() > 256)
+            break;
+        if(indices.emplace(pixel, uint8_t(colors.size())).second)
+            colors.push_back(pixel);
+    }
+    CacheWriter writer;
+    writer.u32(THUMBNAIL_MAGIC);
+    writer.u16(THUMBNAIL_FORMAT);
+    writer.u16(uint16_t(screenshot.width));
+    writer.u16(uint16_t(screenshot.height));
+    if(colors.size() > 256) {
+        writer.u16(0);
+        for(auto pixel : screenshot.pixel)
+            writer.u32(pixel);
+    }
+    else {
+        writer.u16(uint16_t(colors.size()));
+        for(auto color : colors)
+            writer.u32(color);
+        int bits = colors.size() <= 2 ? 1 : colors.size() <= 4 ? 2 : colors.size() <= 16 ? 4 : 8;
+        int shift = 8;
+        uint8_t byte = 0;
+        for(auto pixel : screenshot.pixel) {
+            shift -= bits;
+            byte |= uint8_t(indices[pixel] << shift);
+            if(!shift) {
+                writer.u8(byte);
+                byte = 0;
+                shift = 8;
+            }
+        }
+        if(shift != 8)
+            writer.u8(byte);
+    }
+    std::error_code ec;
+    fs::create_directories(_thumbnailDirectory, ec);
+    auto file = (fs::path(_thumbnailDirectory) / (key + ".c8t")).string();
+    auto tempFile = file + ".tmp";
+    if(writeFile(tempFile, (const char*)writer.data().data(), writer.data().size()))
+        fs::rename(tempFile, file, ec);
+}
+
 bool Librarian::isPrefixedTPDRom(const uint8_t* data, size_t size)
 {
     static const uint8_t magic[] = {0x12, 0x60, 0x01, 0x7a, 0x42, 0x70, 0x22, 0x78};
@@ -28,9 +28,22 @@
 #include <emulation/chip8options.hpp>
 #include <chiplet/chip8variants.hpp>
 #include <configuration.hpp>
+#include <directorywatcher.hpp>
+#include <sha1digest.hpp>
 
+#include <array>
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 struct KnownRomInfo {
@@ -69,36 +82,112 @@ public:
         std::vector<uint32_t> pixel;
     };
     Librarian(const CadmiumConfiguration& cfg);
+    ~Librarian();
+    Librarian(const Librarian&) = delete;
+    Librarian& operator=(const Librarian&) = delete;
     std::string currentDirectory() const { return _currentPath; }
     std::string fullPath(std::string file) const;
     bool fetchDir(std::string directory);
     bool intoDir(std::string subDirectory);
     bool parentDir();
     bool update(const emu::Chip8EmulatorOptions& options);
+    // enables the persistent analysis cache, it is loaded on first use
+    void setCacheFile(const std::string& filename) { _cacheFile = filename; }
+    bool isAnalyzing() const { return _analyzing; }
+    // analyzed and total entries of the current directory
+    std::pair<size_t, size_t> analysisProgress() const { return {_numAnalyzed, _directoryEntries.size()}; }
 
     size_t numEntries() const { return _directoryEntries.size(); }
     const Info& getInfo(size_t index) { return _directoryEntries[index]; }
     void select(int index) { _activeEntry = index; }
     int getSelectedIndex() const { return _activeEntry; }
-    bool isKnownFile(const uint8_t* data, size_t size) const;
+    // lookups take the digest of a ROM, so callers hash it once and pass that around
+    bool isKnownFile(const Sha1Digest& digest) const;
     bool isKnownFile(const std::string& sha1sum) const;
-    emu::Chip8EmulatorOptions::SupportedPreset getPresetForFile(std::string sha1sum) const;
-    emu::Chip8EmulatorOptions::SupportedPreset getPresetForFile(const uint8_t* data, size_t size) const;
+    emu::Chip8EmulatorOptions::SupportedPreset getPresetForFile(const Sha1Digest& digest) const;
+    emu::Chip8EmulatorOptions::SupportedPreset getPresetForFile(const std::string& sha1sum) const;
     emu::Chip8EmulatorOptions::SupportedPreset getEstimatedPresetForFile(emu::Chip8EmulatorOptions::SupportedPreset currentPreset, const uint8_t* data, size_t size) const;
-    emu::Chip8EmulatorOptions getOptionsForFile(const uint8_t* data, size_t size) const;
+    emu::Chip8EmulatorOptions getOptionsForFile(const Sha1Digest& digest) const;
     emu::Chip8EmulatorOptions getOptionsForFile(const std::string& sha1sum) const;
     Screenshot genScreenshot(const Info& info, const std::array<uint32_t, 256> palette) const;
+    // runs the ROM headless for maxFrames frames or until timeLimit is used up, if not zero
+    static Screenshot renderScreenshot(const std::string& romPath, const std::array<uint32_t, 256>& palette, int maxFrames = 5000, std::chrono::milliseconds timeLimit = std::chrono::milliseconds(100));
+    // enables the persistent thumbnail cache, thumbnails are keyed by SHA1 of the file, preset and palette
+    void setThumbnailDirectory(const std::string& directory) { _thumbnailDirectory = directory; }
+    // Returns the thumbnail of an analyzed entry or nothing while it is still generated by the
+    // background worker, entries without a screen result in an empty screenshot
+    std::optional<Screenshot> getThumbnail(const Info& info, const std::array<uint32_t, 256>& palette);
+    // queues missing thumbnails of the given entries, e.g. the ones visible in the browser
+    void prefetchThumbnails(size_t first, size_t count, const std::array<uint32_t, 256>& palette);
     static bool isPrefixedTPDRom(const uint8_t* data, size_t size);
     static bool isPrefixedRSTDPRom(const uint8_t* data, size_t size);
     static size_t numKnownRoms();
     static const KnownRomInfo& getRomInfo(size_t index);
     static const KnownRomInfo* getKnownRoms();
-    static const KnownRomInfo* findKnownRom(const std::string sha1);
+    static const KnownRomInfo* findKnownRom(const Sha1Digest& digest);
+    static const KnownRomInfo* findKnownRom(std::string_view sha1);
     static emu::Chip8EmulatorOptions getOptionsForSha1(const std::string_view& sha1);
 private:
+    struct AnalysisBatch;
+    struct AnalysisResult
+    {
+        Sha1Digest digest;
+        bool inKnownRoms{false};
+        emu::Chip8Variant possibleVariants{};
+        emu::Chip8EmulatorOptions::SupportedPreset estimatedPreset{emu::Chip8EmulatorOptions::eCHIP8};
+    };
+    struct CacheEntry
+    {
+        uint64_t fileSize{0};
+        int64_t fileTime{0};
+        emu::Chip8EmulatorOptions::SupportedPreset preset{emu::Chip8EmulatorOptions::eCHIP8};  // preset the estimate was made for
+        AnalysisResult result;
+    };
+    bool applyDirectoryChanges();
+    void startAnalysis(const emu::Chip8EmulatorOptions& options);
+    void cancelAnalysis();
+    void analysisWorker();
+    void publishResult(Info& entry, bool decompiled, const AnalysisResult& result);
+    static void analyzeJobs(AnalysisBatch& batch, size_t first, size_t count);
+    static emu::Chip8EmulatorOptions::SupportedPreset estimatePreset(emu::Chip8Variant possibleVariants, emu::Chip8EmulatorOptions::SupportedPreset preset, emu::Chip8Variant presetVariant);
+    void loadCache();
+    void saveCache();
+    struct ThumbnailJob
+    {
+        std::string key;
+        std::string path;
+        std::array<uint32_t, 256> palette;
+        std::string suffix;  // preset and palette part of the key
+        bool hashed{false};  // key starts with the SHA1, otherwise the file name needs the content hashed
+    };
+    static uint32_t paletteHash(const std::array<uint32_t, 256>& palette);
+    ThumbnailJob thumbnailJob(const Info& info, const std::array<uint32_t, 256>& palette, uint32_t paletteHash) const;
+    void queueThumbnail(ThumbnailJob job, bool urgent);
+    void thumbnailWorker();
+    bool loadThumbnail(const std::string& key, Screenshot& screenshot) const;
+    void saveThumbnail(const std::string& key, const Screenshot& screenshot) const;
     int _activeEntry{-1};
     std::string _currentPath;
     std::vector<Info> _directoryEntries;
+    DirectoryWatcher _watcher;
     const CadmiumConfiguration& _cfg;
     bool _analyzing{false};
+    size_t _numAnalyzed{0};
+    std::shared_ptr<AnalysisBatch> _batch;
+    std::vector<std::thread> _workers;
+    std::mutex _workerMutex;
+    std::condition_variable _workerCondition;
+    bool _shutdown{false};
+    std::string _cacheFile;
+    std::unordered_map<std::string, CacheEntry> _cache;
+    bool _cacheLoaded{false};
+    bool _cacheDirty{false};
+    std::string _thumbnailDirectory;
+    std::unordered_map<std::string, Screenshot> _thumbnails;  // finished ones, guarded by _thumbnailMutex
+    std::deque<ThumbnailJob> _thumbnailQueue;
+    std::thread _thumbnailThread;
+    std::mutex _thumbnailMutex;
+    std::condition_variable _thumbnailCondition;
+    bool _thumbnailShutdown{false};
+    std::array<size_t, 4> _lastPrefetch{};  // first, count, analyzed entries and palette hash of the last prefetch
 };
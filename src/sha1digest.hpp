@@ -0,0 +1,113 @@
+//---------------------------------------------------------------------------------------
+// src/sha1digest.hpp
+//---------------------------------------------------------------------------------------
+//
+// Copyright (c) 2023, Steffen Schümann <s.schuemann@pobox.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//---------------------------------------------------------------------------------------
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <emulation/sha1hasher.hpp>
+
+//---------------------------------------------------------------------------------------
+// A binary SHA1 digest, stored as the five big endian words of the SHA1 state, so it
+// orders exactly like the lower case hex string and compares in at most five steps.
+//---------------------------------------------------------------------------------------
+struct Sha1Digest
+{
+    std::array<uint32_t, 5> words{};
+
+    static Sha1Digest calculate(const uint8_t* data, size_t size)
+    {
+        return {emu::Sha1Hasher::hash(data, size)};
+    }
+
+    // Hashes a stream in chunks of the given buffer, so files never have to be loaded
+    // completely, the number of bytes hashed is returned in size if given
+    static Sha1Digest calculate(std::istream& is, std::vector<uint8_t>& buffer, uint64_t* size = nullptr)
+    {
+        emu::Sha1Hasher hasher;
+        uint64_t total = 0;
+        while(is) {
+            is.read((char*)buffer.data(), std::streamsize(buffer.size()));
+            auto bytes = is.gcount();
+            hasher.add(buffer.data(), size_t(bytes));
+            total += uint64_t(bytes);
+        }
+        if(size)
+            *size = total;
+        return {hasher.finalize()};
+    }
+
+    // Returns a zero digest if the given text is not a 40 digit hex string
+    static constexpr Sha1Digest fromHex(std::string_view hex)
+    {
+        Sha1Digest result;
+        if(hex.size() != 40)
+            return result;
+        for(size_t i = 0; i < 40; ++i) {
+            auto val = hexValue(hex[i]);
+            if(val < 0)
+                return Sha1Digest{};
+            result.words[i / 8] = (result.words[i / 8] << 4) | uint32_t(val);
+        }
+        return result;
+    }
+
+    std::string toHex() const
+    {
+        static const char* alphabet = "0123456789abcdef";
+        std::string result(40, '0');
+        for(size_t i = 0; i < 40; ++i)
+            result[i] = alphabet[(words[i / 8] >> (28 - (i % 8) * 4)) & 0xf];
+        return result;
+    }
+
+    constexpr bool isZero() const { return !(words[0] | words[1] | words[2] | words[3] | words[4]); }
+
+    constexpr bool operator==(const Sha1Digest& other) const
+    {
+        return words[0] == other.words[0] && words[1] == other.words[1] && words[2] == other.words[2] && words[3] == other.words[3] && words[4] == other.words[4];
+    }
+    constexpr bool operator!=(const Sha1Digest& other) const { return !(*this == other); }
+    constexpr bool operator<(const Sha1Digest& other) const
+    {
+        for(size_t i = 0; i < 5; ++i) {
+            if(words[i] != other.words[i])
+                return words[i] < other.words[i];
+        }
+        return false;
+    }
+
+private:
+    static constexpr int hexValue(char c)
+    {
+        return c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : c >= 'A' && c <= 'F' ? c - 'A' + 10 : -1;
+    }
+};
@@ -0,0 +1,67 @@
+//---------------------------------------------------------------------------------------
+// src/triplebuffer.hpp
+//---------------------------------------------------------------------------------------
+//
+// Copyright (c) 2023, Steffen Schümann <s.schuemann@pobox.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//---------------------------------------------------------------------------------------
+#pragma once
+
+#include <array>
+#include <atomic>
+
+//---------------------------------------------------------------------------------------
+// Lock-free triple buffer for handing complete frames from one producer to one consumer,
+// the producer never waits and the consumer always gets the latest published frame
+//---------------------------------------------------------------------------------------
+template<typename T>
+class TripleBuffer
+{
+public:
+    // Producer side: the buffer to fill next
+    T& back() { return _buffers[_back]; }
+
+    // Producer side: makes the back buffer the latest frame
+    void publish()
+    {
+        _back = _middle.exchange(_back | FRESH, std::memory_order_acq_rel) & INDEX_MASK;
+    }
+
+    // Consumer side: fetches the latest frame if there is one, returns false if nothing new was published
+    bool consume()
+    {
+        if (!(_middle.load(std::memory_order_relaxed) & FRESH))
+            return false;
+        _front = _middle.exchange(_front, std::memory_order_acq_rel) & INDEX_MASK;
+        return true;
+    }
+
+    // Consumer side: the frame fetched by the last successful consume
+    const T& front() const { return _buffers[_front]; }
+
+private:
+    static constexpr int INDEX_MASK = 3;
+    static constexpr int FRESH = 4;
+    std::array<T, 3> _buffers{};
+    int _back{0};
+    std::atomic_int _middle{1};
+    int _front{2};
+};
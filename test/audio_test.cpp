@@ -0,0 +1,355 @@
+//---------------------------------------------------------------------------------------
+// test/audio_test.cpp
+//---------------------------------------------------------------------------------------
+//
+// Copyright (c) 2023, Steffen Schümann <s.schuemann@pobox.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//---------------------------------------------------------------------------------------
+
+#include <doctest/doctest.h>
+
+#include <emulation/chip8cores.hpp>
+#include <emulation/chip8emulatorhost.hpp>
+#include <emulation/chipsound.hpp>
+#include <emulation/oscillator.hpp>
+#include <emulation/wavfile.hpp>
+
+#include <fmt/format.h>
+#include <ghc/fs_fwd.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <iterator>
+#include <vector>
+
+using namespace emu;
+namespace fs = ghc::filesystem;
+
+//---------------------------------------------------------------------------------------
+// The audio of the cores is rendered headless into WAV files and compared against the
+// naive float phase renderers that were used before the band-limited oscillators. Set
+// CADMIUM_AUDIO_TEST_DIR to keep the files for listening, otherwise the temp dir is used.
+//---------------------------------------------------------------------------------------
+namespace {
+
+constexpr int SAMPLE_RATE = 44100;
+constexpr int FRAME_SAMPLES = SAMPLE_RATE / 60;
+
+class AudioTestHost : public Chip8EmulatorHost
+{
+public:
+    ~AudioTestHost() override = default;
+    bool isHeadless() const override { return true; }
+    int getKeyPressed() override { return 0; }
+    bool isKeyDown(uint8_t key) override { return false; }
+    const std::array<bool,16>& getKeyStates() const override { static const std::array<bool,16> keys{}; return keys; }
+    void updateScreen() override {}
+    void vblank() override {}
+    void updatePalette(const std::array<uint8_t,16>& palette) override {}
+    void updatePalette(const std::vector<uint32_t>& palette, size_t offset) override {}
+};
+
+std::vector<int16_t> referenceSquare(float frequency, size_t frames)
+{
+    std::vector<int16_t> result;
+    float phase = 0;
+    const float step = frequency / SAMPLE_RATE;
+    for(size_t i = 0; i < frames; ++i) {
+        result.push_back(phase > 0.5f ? 16384 : -16384);
+        phase = std::fmod(phase + step, 1.0f);
+    }
+    return result;
+}
+
+std::vector<int16_t> referencePattern(const uint8_t* pattern, uint8_t pitch, size_t frames)
+{
+    std::vector<int16_t> result;
+    float phase = 0;
+    auto step = 4000 * std::pow(2.0f, (float(pitch) - 64) / 48.0f) / 128 / SAMPLE_RATE;
+    for(size_t i = 0; i < frames; ++i) {
+        auto pos = int(std::clamp(phase * 128.0f, 0.0f, 127.0f));
+        result.push_back(pattern[pos >> 3] & (1 << (7 - (pos & 7))) ? 16384 : -16384);
+        phase = std::fmod(phase + step, 1.0f);
+    }
+    return result;
+}
+
+std::vector<int16_t> renderInFrames(const std::function<void(int16_t*, size_t)>& render, size_t frames)
+{
+    std::vector<int16_t> result(frames);
+    for(size_t offset = 0; offset < frames; offset += FRAME_SAMPLES) {
+        render(result.data() + offset, std::min(frames - offset, size_t(FRAME_SAMPLES)));
+    }
+    return result;
+}
+
+// Writes the samples as WAV and reads the data chunk back, so the files on disk are what gets compared
+std::vector<int16_t> wavRoundTrip(const std::string& name, const std::vector<int16_t>& samples)
+{
+    const char* dir = std::getenv("CADMIUM_AUDIO_TEST_DIR");
+    auto file = (dir ? fs::path(dir) : fs::temp_directory_path()) / (name + ".wav");
+    REQUIRE(writeWavFile(file.string(), samples.data(), samples.size(), SAMPLE_RATE));
+    int sampleFrequency = 0;
+    auto result = readWavFile(file.string(), &sampleFrequency);
+    if(!dir) {
+        fs::remove(file);
+    }
+    CHECK(sampleFrequency == SAMPLE_RATE);
+    REQUIRE(result.size() == samples.size());
+    return result;
+}
+
+// Away from the edges of the reference both renderings have to be identical, close to an
+// edge the band-limited one has to stay between the two levels
+void compareToReference(const std::string& name, const std::vector<int16_t>& rendered, const std::vector<int16_t>& reference)
+{
+    auto samples = wavRoundTrip(name, rendered);
+    wavRoundTrip(name + "-reference", reference);
+    REQUIRE(samples.size() == reference.size());
+    int edges = 0, mismatches = 0, outOfRange = 0;
+    for(size_t i = 0; i < samples.size(); ++i) {
+        if(i && reference[i] != reference[i - 1])
+            ++edges;
+        if(samples[i] < -16384 || samples[i] > 16384)
+            ++outOfRange;
+        if(samples[i] != reference[i]) {
+            // the start of the sound is an edge from silence too
+            bool nearEdge = i < 3;
+            for(size_t j = i > 3 ? i - 3 : 0; j < std::min(i + 3, samples.size() - 1); ++j) {
+                nearEdge |= reference[j] != reference[j + 1];
+            }
+            if(!nearEdge)
+                ++mismatches;
+        }
+    }
+    INFO(name);
+    CHECK(edges > 0);
+    CHECK(mismatches == 0);
+    CHECK(outOfRange == 0);
+}
+
+}
+
+TEST_CASE("Audio - square oscillator")
+{
+    for(float frequency : {1000.0f, 1200.0f, 1400.0f, 1531.555f, 2400.0f, 27535.0f / 128}) {
+        uint32_t phase = 0;
+        auto step = oscillator::phaseStep(frequency, SAMPLE_RATE);
+        auto samples = renderInFrames([&](int16_t* out, size_t frames) { oscillator::renderSquare(out, frames, phase, step); }, SAMPLE_RATE / 2);
+        compareToReference(fmt::format("square-{}", int(frequency)), samples, referenceSquare(frequency, SAMPLE_RATE / 2));
+    }
+}
+
+TEST_CASE("Audio - square oscillator is band-limited")
+{
+    uint32_t phase = 0;
+    std::vector<int16_t> samples(SAMPLE_RATE / 10);
+    oscillator::renderSquare(samples.data(), samples.size(), phase, oscillator::phaseStep(1531.555, SAMPLE_RATE));
+    int intermediate = 0;
+    for(auto sample : samples) {
+        if(sample != 16384 && sample != -16384)
+            ++intermediate;
+    }
+    // roughly two corrected samples per edge, an aliasing square has none
+    CHECK(intermediate > 1531 / 10);
+    CHECK(intermediate < 4 * 2 * 1532 / 10);
+}
+
+TEST_CASE("Audio - block size does not change the output")
+{
+    const uint8_t pattern[16] = {0x00, 0xFF, 0x0F, 0xF0, 0x33, 0xCC, 0x55, 0xAA, 0x01, 0x80, 0x7E, 0x81, 0x00, 0x00, 0xFF, 0xFF};
+    auto step = oscillator::phaseStep(4000.0 / 128 * 1.7, SAMPLE_RATE);
+    std::vector<int16_t> whole(4096), blocks(4096);
+    uint32_t phase = 0;
+    oscillator::renderPattern(whole.data(), whole.size(), phase, step, pattern);
+    phase = 0;
+    for(size_t offset = 0, size = 1; offset < blocks.size(); offset += size, size = size % 97 + 1) {
+        oscillator::renderPattern(blocks.data() + offset, std::min(size, blocks.size() - offset), phase, step, pattern);
+    }
+    CHECK(whole == blocks);
+}
+
+TEST_CASE("Audio - XO-CHIP pattern tables")
+{
+    const uint8_t pattern1[16] = {0x00, 0xFF, 0x0F, 0xF0, 0x33, 0xCC, 0x55, 0xAA, 0x01, 0x80, 0x7E, 0x81, 0x00, 0x00, 0xFF, 0xFF};
+    const uint8_t pattern2[16] = {0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0};
+    oscillator::PatternTableCache cache;
+    for(uint8_t pitch : {uint8_t(0), uint8_t(64), uint8_t(112)}) {
+        uint32_t phase = 0;
+        auto step = oscillator::phaseStep(4000 * std::pow(2.0, (double(pitch) - 64) / 48.0) / 128, SAMPLE_RATE);
+        auto samples = renderInFrames([&](int16_t* out, size_t frames) { cache.render(out, frames, phase, step, pattern1); }, SAMPLE_RATE / 4);
+        compareToReference(fmt::format("xo-table-{}", pitch), samples, referencePattern(pattern1, pitch, SAMPLE_RATE / 4));
+    }
+    CHECK(cache.tablesBuilt() == 3);
+    // alternating patterns as used by music ROMs are served from the cache
+    uint32_t phase = 0;
+    auto step = oscillator::phaseStep(4000.0 / 128, SAMPLE_RATE);
+    std::vector<int16_t> samples(FRAME_SAMPLES);
+    for(int frame = 0; frame < 60; ++frame) {
+        cache.render(samples.data(), samples.size(), phase, step, frame & 1 ? pattern2 : pattern1);
+    }
+    CHECK(cache.tablesBuilt() == 4);
+}
+
+TEST_CASE("Audio - XO-CHIP pattern tables are built for alternating sounds only")
+{
+    const uint8_t pattern1[16] = {0x00, 0xFF, 0x0F, 0xF0, 0x33, 0xCC, 0x55, 0xAA, 0x01, 0x80, 0x7E, 0x81, 0x00, 0x00, 0xFF, 0xFF};
+    const uint8_t pattern2[16] = {0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0, 0xF0};
+    auto step = oscillator::phaseStep(4000.0 / 128, SAMPLE_RATE);
+    std::vector<int16_t> samples(FRAME_SAMPLES);
+    uint32_t phase = 0;
+    // two sounds never seen before, alternating every block, get tables on their second use
+    oscillator::PatternTableCache cache;
+    for(int frame = 0; frame < 60; ++frame) {
+        cache.render(samples.data(), samples.size(), phase, step, frame & 1 ? pattern2 : pattern1);
+    }
+    CHECK(cache.tablesBuilt() == 2);
+    // a pattern that changes every block is rendered directly
+    oscillator::PatternTableCache changing;
+    uint8_t pattern[16] = {};
+    for(int frame = 0; frame < 60; ++frame) {
+        pattern[0] = uint8_t(frame);
+        changing.render(samples.data(), samples.size(), phase, step, pattern);
+    }
+    CHECK(changing.tablesBuilt() == 0);
+}
+
+TEST_CASE("Audio - XO-CHIP pattern playback of the core")
+{
+    const uint8_t pattern[16] = {0x00, 0xFF, 0x0F, 0xF0, 0x33, 0xCC, 0x55, 0xAA, 0x01, 0x80, 0x7E, 0x81, 0x00, 0x00, 0xFF, 0xFF};
+    for(uint8_t pitch : {uint8_t(32), uint8_t(64), uint8_t(112)}) {
+        AudioTestHost host;
+        auto options = Chip8EmulatorOptions::optionsOfPreset(Chip8EmulatorOptions::eXOCHIP);
+        Chip8EmulatorFP chip8(host, options);
+        chip8.reset();
+        const uint16_t program[] = {
+            0xA210,                 // i := 0x210
+            0xF002,                 // audio
+            uint16_t(0x6000 | pitch),
+            0xF03A,                 // pitch := v0
+            0x6FFF,
+            0xFF18,                 // buzzer := vF
+            0x120C                  // loop: jump loop
+        };
+        for(size_t i = 0; i < std::size(program); ++i) {
+            chip8.memory()[0x200 + i * 2] = program[i] >> 8;
+            chip8.memory()[0x201 + i * 2] = program[i] & 0xff;
+        }
+        std::copy(std::begin(pattern), std::end(pattern), chip8.memory() + 0x210);
+        chip8.executeInstructions(7);
+        REQUIRE(chip8.soundTimer() == 255);
+        auto samples = renderInFrames([&](int16_t* out, size_t frames) { chip8.renderAudio(out, frames, SAMPLE_RATE); }, SAMPLE_RATE / 4);
+        compareToReference(fmt::format("xo-pattern-{}", pitch), samples, referencePattern(pattern, pitch, SAMPLE_RATE / 4));
+    }
+}
+
+TEST_CASE("Audio - ChipSound tone is a note number")
+{
+    // pulse wave at full sustain without filter, 69 is A4
+    for(auto [note, frequency] : {std::pair<uint8_t, int>{69, 440}, {81, 880}, {57, 220}}) {
+        const uint8_t voice[7] = {note, 128, ChipSound::ePULSE << 5, 0x00, 0xF0, 0x00, 0x00};
+        ChipSound chipSound(SAMPLE_RATE);
+        chipSound.updateParameters(0, voice);
+        auto samples = renderInFrames([&](int16_t* out, size_t frames) { chipSound.render(out, frames); }, SAMPLE_RATE + SAMPLE_RATE / 10);
+        int periods = 0;
+        for(size_t i = SAMPLE_RATE / 10; i < samples.size(); ++i) {
+            if(samples[i - 1] < 0 && samples[i] >= 0)
+                ++periods;
+        }
+        INFO("note " << int(note));
+        CHECK(std::abs(periods - frequency) <= 1);
+    }
+}
+
+TEST_CASE("Audio - ChipSound envelope")
+{
+    const uint8_t voice[7] = {69, 128, ChipSound::eSAW << 5, 0x43, 0x82, 0x00, 0x00};
+    ChipSound chipSound(SAMPLE_RATE);
+    const int attackSamples = std::max(1, int(chipSound.envelopeTime(4) * SAMPLE_RATE));
+    const int decaySamples = std::max(1, int(chipSound.envelopeTime(3) * 3 * SAMPLE_RATE));
+    const float sustainLevel = 8 / 15.0f;
+    const int releaseSamples = std::max(1, int(std::max(1, int(chipSound.envelopeTime(2) * 3 * SAMPLE_RATE)) * sustainLevel));
+    std::vector<int16_t> samples(SAMPLE_RATE);
+    CHECK(chipSound.envelopeState(0) == ChipSound::eIDLE);
+    chipSound.updateParameters(0, voice);
+    chipSound.render(samples.data(), attackSamples - 1);
+    CHECK(chipSound.envelopeState(0) == ChipSound::eATTACK);
+    chipSound.render(samples.data(), 1);
+    CHECK(chipSound.envelopeState(0) == ChipSound::eDECAY);
+    CHECK(chipSound.envelopeLevel(0) == 1.0f);
+    chipSound.render(samples.data(), decaySamples);
+    CHECK(chipSound.envelopeState(0) == ChipSound::eSUSTAIN);
+    CHECK(chipSound.envelopeLevel(0) == sustainLevel);
+    chipSound.render(samples.data(), samples.size());
+    CHECK(chipSound.envelopeState(0) == ChipSound::eSUSTAIN);
+    CHECK(chipSound.envelopeLevel(0) == sustainLevel);
+    // the release starts from the sustain level
+    chipSound.noteOff(0);
+    chipSound.render(samples.data(), releaseSamples - 1);
+    CHECK(chipSound.envelopeState(0) == ChipSound::eRELEASE);
+    auto level = chipSound.envelopeLevel(0);
+    CHECK(level > 0.0f);
+    CHECK(level < sustainLevel);
+    // a retrigger ramps up from the current level instead of restarting at zero
+    chipSound.updateParameters(0, voice);
+    chipSound.render(samples.data(), 1);
+    CHECK(chipSound.envelopeState(0) == ChipSound::eATTACK);
+    CHECK(chipSound.envelopeLevel(0) > level);
+    chipSound.noteOff(0);
+    chipSound.render(samples.data(), samples.size());
+    CHECK(chipSound.envelopeState(0) == ChipSound::eIDLE);
+    CHECK(chipSound.envelopeLevel(0) == 0.0f);
+    // an idle voice stays silent
+    CHECK(std::all_of(samples.end() - 100, samples.end(), [](int16_t sample) { return sample == 0; }));
+}
+
+TEST_CASE("Audio - ChipSound SSE2 and scalar rendering match")
+{
+    static const uint8_t voices[4][7] = {
+        {69, 128, ChipSound::ePULSE << 5, 0x12, 0xA4, 0x80, 0x10},
+        {57, 64, ChipSound::eSAW << 5, 0x34, 0x83, 0x40, 0x2A},
+        {81, 0, ChipSound::eSINE << 5, 0x00, 0xF2, 0x00, 0x00},
+        {60, 0, ChipSound::eNOISE << 5, 0x01, 0x31, 0xC0, 0x45}
+    };
+    auto render = [](bool scalar, size_t blockSize) {
+        ChipSound chipSound(SAMPLE_RATE);
+        chipSound.setScalar(scalar);
+        for(uint8_t voice = 0; voice < 4; ++voice) {
+            chipSound.updateParameters(voice, voices[voice]);
+        }
+        std::vector<int16_t> result(SAMPLE_RATE);
+        for(size_t offset = 0; offset < result.size(); offset += blockSize) {
+            if(offset >= result.size() / 2 && offset < result.size() / 2 + blockSize) {
+                chipSound.noteOff(0);
+                chipSound.updateParameters(3, voices[3]);
+            }
+            chipSound.render(result.data() + offset, std::min(blockSize, result.size() - offset));
+        }
+        return result;
+    };
+    auto scalar = render(true, FRAME_SAMPLES);
+    CHECK(std::any_of(scalar.begin(), scalar.end(), [](int16_t sample) { return sample != 0; }));
+    CHECK(render(false, FRAME_SAMPLES) == scalar);
+    // odd block sizes leave partial vectors at the end of every block
+    CHECK(render(false, 97) == render(true, 97));
+}
@@ -496,4 +496,31 @@ TEST_CASE(C8CORE "Fx65 - load vx")
     CheckState(chip8, {.i = -1, .pc= 0x204, .sp = 0, .dt = TIMER_DEFAULT, .st = TIMER_DEFAULT, .v = {0x33,0x99,0,0, 0,0,0,0, 0,0,0,0, 0,0,0,0}, .stack = {}}, "load v1");
 }
 
+#ifdef TEST_CHIP8EMULATOR_STRICT
+TEST_CASE(C8CORE "Dxyn - converted screen stays 64x32")
+{
+    auto chip8 = createChip8Instance();
+    chip8->reset();
+    std::array<uint32_t,256> palette{};
+    palette[1] = 0xFFFFFFFF;
+    chip8->setPalette(palette);
+    chip8->memory()[0x300] = 0xFF;
+    write(chip8, 0x200, {0xA300, 0xD011});
+    for (int i = 0; i < 100 && chip8->getPC() != 0x204; ++i)
+        step(chip8);
+    REQUIRE(chip8->getPC() == 0x204);
+    auto* screen = chip8->getScreen();
+    REQUIRE(screen);
+    CHECK(screen->width() == 64);
+    CHECK(screen->height() == 32);
+    std::vector<uint32_t> buffer(64 * 32 + 64, 0x12345678);
+    screen->convert(buffer.data(), 64, 255);
+    CHECK(buffer[0] == buffer[7]);
+    CHECK(buffer[0] != buffer[8]);
+    CHECK(buffer[64] == buffer[8]);
+    for (size_t i = 64 * 32; i < buffer.size(); ++i)
+        CHECK(buffer[i] == 0x12345678);
+}
+#endif
+
 TEST_SUITE_END();
@@ -0,0 +1,123 @@
+//---------------------------------------------------------------------------------------
+// test/sha1_test.cpp
+//---------------------------------------------------------------------------------------
+//
+// Copyright (c) 2023, Steffen Schümann <s.schuemann@pobox.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//---------------------------------------------------------------------------------------
+
+#include <doctest/doctest.h>
+
+#include <emulation/sha1hasher.hpp>
+#include <sha1/sha1.hpp>
+
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace emu;
+
+static std::string toHex(const Sha1Hasher::State& state)
+{
+    static const char* alphabet = "0123456789abcdef";
+    std::string result;
+    for(auto word : state) {
+        for(int i = 28; i >= 0; i -= 4)
+            result += alphabet[(word >> i) & 0xf];
+    }
+    return result;
+}
+
+static Sha1Hasher::State referenceHash(const std::vector<uint8_t>& data)
+{
+    sha1 sum;
+    sum.add(data.data(), uint32_t(data.size()));
+    sum.finalize();
+    return {sum.state[0], sum.state[1], sum.state[2], sum.state[3], sum.state[4]};
+}
+
+static std::vector<Sha1Hasher::Backend> supportedBackends()
+{
+    std::vector<Sha1Hasher::Backend> result;
+    for(auto backend : {Sha1Hasher::eSCALAR, Sha1Hasher::eSHA_NI}) {
+        if(Sha1Hasher::isSupported(backend))
+            result.push_back(backend);
+    }
+    return result;
+}
+
+TEST_CASE("Sha1Hasher - known digests")
+{
+    auto initialBackend = Sha1Hasher::backend();
+    for(auto backend : supportedBackends()) {
+        Sha1Hasher::setBackend(backend);
+        INFO("backend: " << Sha1Hasher::backendName(backend));
+        CHECK(toHex(Sha1Hasher::hash(nullptr, 0)) == "da39a3ee5e6b4b0d3255bfef95601890afd80709");
+        const std::string fox = "The quick brown fox jumps over the lazy dog";
+        CHECK(toHex(Sha1Hasher::hash((const uint8_t*)fox.data(), fox.size())) == "2fd4e1c67a2d28fced849ee1bb76e7391b93eb12");
+        const std::string digits = "01234567890123456789012345678901234567890123456789012345678901234";
+        CHECK(toHex(Sha1Hasher::hash((const uint8_t*)digits.data(), 55)) == "9f3a4ce7f66b1b74c34da2c5d732c39f81e0f8df");
+        std::vector<uint8_t> alphabet(26 * 1000 * 100);
+        for(size_t i = 0; i < alphabet.size(); ++i)
+            alphabet[i] = uint8_t('a' + i % 26);
+        CHECK(Sha1Hasher::hash(alphabet.data(), alphabet.size()) == referenceHash(alphabet));
+    }
+    Sha1Hasher::setBackend(initialBackend);
+}
+
+TEST_CASE("Sha1Hasher - streaming and multi-buffer match the reference")
+{
+    auto initialBackend = Sha1Hasher::backend();
+    std::mt19937 rng(4711);
+    std::vector<std::vector<uint8_t>> messages;
+    for(size_t size = 0; size < 200; ++size)
+        messages.emplace_back(size);
+    for(int i = 0; i < 50; ++i)
+        messages.emplace_back(rng() % 8192);
+    for(auto& message : messages) {
+        for(auto& byte : message)
+            byte = uint8_t(rng());
+    }
+    std::vector<Sha1Hasher::Input> inputs;
+    for(const auto& message : messages)
+        inputs.push_back({message.data(), message.size()});
+    for(auto backend : supportedBackends()) {
+        Sha1Hasher::setBackend(backend);
+        INFO("backend: " << Sha1Hasher::backendName(backend));
+        std::vector<Sha1Hasher::State> results(inputs.size());
+        Sha1Hasher::hashMany(inputs.data(), inputs.size(), results.data());
+        for(size_t i = 0; i < messages.size(); ++i) {
+            INFO("message size: " << messages[i].size());
+            auto expected = referenceHash(messages[i]);
+            CHECK(Sha1Hasher::hash(messages[i].data(), messages[i].size()) == expected);
+            CHECK(results[i] == expected);
+            Sha1Hasher hasher;
+            size_t offset = 0;
+            while(offset < messages[i].size()) {
+                auto chunk = std::min(size_t(rng() % 100), messages[i].size() - offset);
+                hasher.add(messages[i].data() + offset, chunk);
+                offset += chunk;
+            }
+            CHECK(hasher.finalize() == expected);
+        }
+    }
+    Sha1Hasher::setBackend(initialBackend);
+}
@@ -0,0 +1,318 @@
+//---------------------------------------------------------------------------------------
+// tools/c8bench.cpp
+//---------------------------------------------------------------------------------------
+//
+// Copyright (c) 2023, Steffen Schümann <s.schuemann@pobox.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//---------------------------------------------------------------------------------------
+// Micro benchmarks for hot paths of the emulation that are not covered by the
+// ROM based `cadmium --benchmark` option.
+//---------------------------------------------------------------------------------------
+
+#include <emulation/chip8cores.hpp>
+#include <emulation/chip8emulatorhost.hpp>
+#include <emulation/chipsound.hpp>
+#include <emulation/crtfilter.hpp>
+#include <emulation/sha1hasher.hpp>
+#include <librarian.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <initializer_list>
+#include <iostream>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <ghc/cli.hpp>
+#include <fmt/format.h>
+
+class BenchmarkHost : public emu::Chip8EmulatorHost
+{
+public:
+    ~BenchmarkHost() override = default;
+    bool isHeadless() const override { return true; }
+    int getKeyPressed() override { return 0; }
+    bool isKeyDown(uint8_t key) override { return false; }
+    const std::array<bool,16>& getKeyStates() const override { static const std::array<bool,16> keys{}; return keys; }
+    void updateScreen() override {}
+    void vblank() override {}
+    void updatePalette(const std::array<uint8_t,16>& palette) override {}
+    void updatePalette(const std::vector<uint32_t>& palette, size_t offset) override {}
+};
+
+static void writeOpcodes(emu::IChip8Emulator& chip8, uint32_t address, std::initializer_list<uint16_t> opcodes)
+{
+    for(auto opcode : opcodes) {
+        chip8.memory()[address++] = opcode >> 8;
+        chip8.memory()[address++] = opcode & 0xff;
+    }
+}
+
+// Runs the given function `iterations` times and returns the average microseconds per call
+static double measure(int64_t iterations, const std::function<void()>& func)
+{
+    auto start = std::chrono::steady_clock::now();
+    for(int64_t i = 0; i < iterations; ++i) {
+        func();
+    }
+    auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    return duration / 1000.0 / iterations;
+}
+
+//---------------------------------------------------------------------------------------
+// MegaChip: a full screen 256x192 sprite drawn once per loop iteration with every
+// blend mode, this is what MegaChip titles do for their backgrounds every frame
+//---------------------------------------------------------------------------------------
+static void benchmarkMegaChipSprites(int64_t iterations)
+{
+    static const char* blendModeNames[] = {"normal", "alpha-25", "alpha-50", "alpha-75", "add", "mul"};
+    BenchmarkHost host;
+    auto options = emu::Chip8EmulatorOptions::optionsOfPreset(emu::Chip8EmulatorOptions::eMEGACHIP);
+    std::mt19937 rng(4711);
+    for(uint16_t blendMode = 0; blendMode < 6; ++blendMode) {
+        emu::Chip8EmulatorFP chip8(host, options);
+        chip8.reset();
+        writeOpcodes(chip8, 0x200, {
+            0x0011,         // megachip on
+            0x0100, 0x0300, // I := 0x000300
+            0x02FF,         // load 255 palette entries
+            0x0300,         // sprite width 256
+            0x04C0,         // sprite height 192
+            uint16_t(0x0800 | blendMode),
+            0x0101, 0x0000, // I := 0x010000
+            0xD011,         // loop: sprite v0 v1 1
+            0x1212          // jump loop
+        });
+        for(int i = 0x300; i < 0x300 + 255 * 4; ++i) {
+            chip8.memory()[i] = rng() & 0xff;
+        }
+        for(int i = 0; i < 256 * 192; ++i) {
+            // roughly a quarter of the pixels is transparent
+            auto col = rng() & 0xff;
+            chip8.memory()[0x10000 + i] = (col & 3) ? col : 0;
+        }
+        chip8.executeInstructions(8);
+        auto micros = measure(iterations, [&chip8]() { chip8.executeInstructions(2); });
+        std::cout << fmt::format("megachip-sprite {:<9} {:10.2f}us/sprite {:8.1f} MPixel/s", blendModeNames[blendMode], micros, 256.0 * 192.0 / micros) << std::endl;
+    }
+}
+
+//---------------------------------------------------------------------------------------
+// Scrolling: a loop of 00Cn/00FB/00FC scrolls as used by scroll heavy SCHIP games,
+// and the same on MegaChip where the indexed and the RGBA screen are scrolled
+//---------------------------------------------------------------------------------------
+static void benchmarkScrolling(int64_t iterations)
+{
+    BenchmarkHost host;
+    for(auto preset : {emu::Chip8EmulatorOptions::eSCHIP11, emu::Chip8EmulatorOptions::eMEGACHIP}) {
+        auto options = emu::Chip8EmulatorOptions::optionsOfPreset(preset);
+        bool isMegaChip = preset == emu::Chip8EmulatorOptions::eMEGACHIP;
+        emu::Chip8EmulatorFP chip8(host, options);
+        chip8.reset();
+        writeOpcodes(chip8, 0x200, {
+            uint16_t(isMegaChip ? 0x0011 : 0x00FF), // megachip on or hires
+            0x00C1,         // loop: scroll-down 1
+            0x00FB,         // scroll-right
+            0x00FC,         // scroll-left
+            0x1202          // jump loop
+        });
+        chip8.executeInstructions(1);
+        auto micros = measure(iterations, [&chip8]() { chip8.executeInstructions(4); });
+        std::cout << fmt::format("scroll {:<18} {:10.2f}us/scroll", emu::Chip8EmulatorOptions::shortNameOfPreset(preset), micros / 3) << std::endl;
+    }
+}
+
+//---------------------------------------------------------------------------------------
+// CRT post-processing: a converted MegaChip and a SCHIP sized frame are filtered at 4x
+// and 8x output scale, once single threaded and once with all worker threads
+//---------------------------------------------------------------------------------------
+static void benchmarkCrtFilter(int64_t iterations)
+{
+    std::mt19937 rng(4711);
+    std::vector<uint32_t> frame(256 * 192);
+    for(auto& pixel : frame) {
+        pixel = rng() | 0xFF000000;
+    }
+    std::vector<uint32_t> output(256 * 8 * 192 * 8);
+    for(auto size : {std::pair{256, 192}, std::pair{128, 64}}) {
+        const int width = size.first, height = size.second;
+        for(int scale : {4, 8}) {
+            for(int threads : {1, 0}) {
+                emu::CrtFilter filter(threads);
+                emu::CrtFilter::Settings settings;
+                settings.scale = scale;
+                filter.setSettings(settings);
+                auto micros = measure(iterations, [&]() { filter.process(frame.data(), width, height, 256, output.data(), width * scale); });
+                std::cout << fmt::format("crt {:>3}x{:<3} {}x {}t {:10.2f}us/frame {:8.1f} MPixel/s {:8.1f} fps", width, height, scale, filter.numThreads(), micros, double(width) * height * scale * scale / micros, 1000000.0 / micros) << std::endl;
+            }
+        }
+    }
+}
+
+//---------------------------------------------------------------------------------------
+// ChipSound: all four voices with different waveforms and filters rendered in frame
+// sized blocks, every iteration is one second of audio at 44.1kHz
+//---------------------------------------------------------------------------------------
+static void benchmarkChipSound(int64_t iterations)
+{
+    static const uint8_t voices[4][7] = {
+        {69, 128, emu::ChipSound::ePULSE << 5, 0x12, 0xA4, 0x80, 0x10},
+        {57, 64, emu::ChipSound::eSAW << 5, 0x34, 0x83, 0x40, 0x2A},
+        {81, 0, emu::ChipSound::eSINE << 5, 0x00, 0xF2, 0x00, 0x00},
+        {60, 0, emu::ChipSound::eNOISE << 5, 0x01, 0x31, 0xC0, 0x45}
+    };
+    emu::ChipSound chipSound;
+    for(uint8_t voice = 0; voice < 4; ++voice) {
+        chipSound.updateParameters(voice, voices[voice]);
+    }
+    std::vector<int16_t> samples(44100);
+    int64_t second = 0;
+    auto micros = measure(iterations, [&]() {
+        // retrigger one voice per second, so the envelopes keep moving
+        chipSound.updateParameters(second & 3, voices[second & 3]);
+        ++second;
+        for(size_t offset = 0; offset < samples.size(); offset += 735) {
+            chipSound.render(samples.data() + offset, 735);
+        }
+    });
+    std::cout << fmt::format("chipsound 4 voices {:10.2f}us/s-audio {:8.0f}x realtime", micros, 1000000.0 / micros) << std::endl;
+}
+
+//---------------------------------------------------------------------------------------
+// Known ROM lookup: every digest of the known ROM table and as many random digests that
+// miss, once as binary digests and once as hex strings like c8db and the URL loader use
+//---------------------------------------------------------------------------------------
+static void benchmarkKnownRomLookup(int64_t iterations)
+{
+    std::mt19937 rng(4711);
+    std::vector<Sha1Digest> digests;
+    for(size_t i = 0; i < Librarian::numKnownRoms(); ++i) {
+        digests.push_back(Sha1Digest::fromHex(Librarian::getRomInfo(i).sha1));
+        Sha1Digest miss;
+        for(auto& word : miss.words) {
+            word = rng();
+        }
+        digests.push_back(miss);
+    }
+    std::vector<std::string> hexDigests;
+    for(const auto& digest : digests) {
+        hexDigests.push_back(digest.toHex());
+    }
+    size_t found = 0;
+    auto micros = measure(iterations, [&]() {
+        for(const auto& digest : digests) {
+            found += Librarian::findKnownRom(digest) != nullptr;
+        }
+    });
+    std::cout << fmt::format("known-rom-lookup digest {:10.2f}ns/lookup ({} roms)", micros * 1000 / digests.size(), Librarian::numKnownRoms()) << std::endl;
+    micros = measure(iterations, [&]() {
+        for(const auto& hex : hexDigests) {
+            found += Librarian::findKnownRom(hex) != nullptr;
+        }
+    });
+    std::cout << fmt::format("known-rom-lookup hex    {:10.2f}ns/lookup", micros * 1000 / hexDigests.size()) << std::endl;
+    if(found != size_t(iterations) * Librarian::numKnownRoms() * 2) {
+        std::cerr << "known-rom-lookup: unexpected number of hits!" << std::endl;
+    }
+}
+
+//---------------------------------------------------------------------------------------
+// SHA1 of a directory full of typical ROM sizes, once hashed one after the other and
+// once through the multi-buffer API the librarian uses, for every supported backend
+//---------------------------------------------------------------------------------------
+static void benchmarkSha1(int64_t iterations)
+{
+    std::mt19937 rng(4711);
+    std::vector<std::vector<uint8_t>> roms(256);
+    std::vector<emu::Sha1Hasher::Input> inputs;
+    size_t totalSize = 0;
+    for(auto& rom : roms) {
+        rom.resize(64 + rng() % 3520);
+        for(auto& byte : rom) {
+            byte = uint8_t(rng());
+        }
+        inputs.push_back({rom.data(), rom.size()});
+        totalSize += rom.size();
+    }
+    std::vector<emu::Sha1Hasher::State> single(roms.size()), many(roms.size());
+    auto previous = emu::Sha1Hasher::backend();
+    for(auto backend : {emu::Sha1Hasher::eSCALAR, emu::Sha1Hasher::eSHA_NI}) {
+        if(!emu::Sha1Hasher::isSupported(backend))
+            continue;
+        emu::Sha1Hasher::setBackend(backend);
+        auto micros = measure(iterations, [&]() {
+            for(size_t i = 0; i < roms.size(); ++i) {
+                single[i] = emu::Sha1Hasher::hash(roms[i].data(), roms[i].size());
+            }
+        });
+        std::cout << fmt::format("sha1 {:7} single {:10.2f}us/dir {:8.1f}MB/s", emu::Sha1Hasher::backendName(backend), micros, totalSize / micros) << std::endl;
+        micros = measure(iterations, [&]() {
+            emu::Sha1Hasher::hashMany(inputs.data(), inputs.size(), many.data());
+        });
+        std::cout << fmt::format("sha1 {:7} many   {:10.2f}us/dir {:8.1f}MB/s", emu::Sha1Hasher::backendName(backend), micros, totalSize / micros) << std::endl;
+        if(single != many) {
+            std::cerr << "sha1: multi-buffer digests differ!" << std::endl;
+        }
+    }
+    emu::Sha1Hasher::setBackend(previous);
+}
+
+int main(int argc, char* argv[])
+{
+    ghc::CLI cli(argc, argv);
+    std::vector<std::string> benchmarks;
+    int64_t iterations = 1000;
+    bool showHelp = false;
+    cli.option({"-h", "--help"}, showHelp, "Show this help text");
+    cli.option({"-n", "--iterations"}, iterations, "Number of iterations per benchmark, default: 1000");
+    cli.positional(benchmarks, "Benchmarks to run, default: all (available: megachip-sprite, scroll, crt, chipsound, known-rom-lookup, sha1)");
+    cli.parse();
+    if(showHelp) {
+        cli.usage();
+        exit(0);
+    }
+    auto selected = [&benchmarks](const std::string& name) {
+        return benchmarks.empty() || std::find(benchmarks.begin(), benchmarks.end(), name) != benchmarks.end();
+    };
+    if(selected("megachip-sprite")) {
+        benchmarkMegaChipSprites(iterations);
+    }
+    if(selected("scroll")) {
+        benchmarkScrolling(iterations);
+    }
+    if(selected("crt")) {
+        benchmarkCrtFilter(iterations);
+    }
+    if(selected("chipsound")) {
+        benchmarkChipSound(iterations);
+    }
+    if(selected("known-rom-lookup")) {
+        benchmarkKnownRomLookup(iterations);
+    }
+    if(selected("sha1")) {
+        benchmarkSha1(iterations);
+    }
+    return 0;
+}
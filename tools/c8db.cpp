@@ -26,13 +26,22 @@
 
 #include <c8db/database.hpp>
 #include <emulation/chip8options.hpp>
+#include <emulation/mappedfile.hpp>
 #include <chiplet/utility.hpp>
 #include <librarian.hpp>
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
 #include <iostream>
 #include <map>
+#include <mutex>
+#include <optional>
 #include <set>
+#include <thread>
 
 #include <ghc/cli.hpp>
 #include <ghc/filesystem.hpp>
@@ -68,6 +77,116 @@ static bool platformMatchesOptions(const c8db::Platform& platform, const emu::Ch
     return false;
 }
 
+//---------------------------------------------------------------------------------------
+// Directory scan pipeline: a walker thread feeds the paths of candidate files into a
+// bounded queue, hashing workers read them in large chunks and hash them while reading,
+// the results are collected and reported sorted by path, so the output is stable no
+// matter which worker finished first.
+//---------------------------------------------------------------------------------------
+class ScanQueue
+{
+public:
+    explicit ScanQueue(size_t capacity) : _capacity(capacity) {}
+    void push(std::string path)
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _notFull.wait(lock, [this]() { return _queue.size() < _capacity; });
+        _queue.push_back(std::move(path));
+        _notEmpty.notify_one();
+    }
+    std::optional<std::string> pop()
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _notEmpty.wait(lock, [this]() { return !_queue.empty() || _closed; });
+        if(_queue.empty())
+            return std::nullopt;
+        auto path = std::move(_queue.front());
+        _queue.pop_front();
+        _notFull.notify_one();
+        return path;
+    }
+    void close()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _closed = true;
+        _notEmpty.notify_all();
+    }
+private:
+    size_t _capacity;
+    std::deque<std::string> _queue;
+    std::mutex _mutex;
+    std::condition_variable _notEmpty;
+    std::condition_variable _notFull;
+    bool _closed{false};
+};
+
+struct ScanResult
+{
+    std::string path;
+    Sha1Digest digest;
+};
+
+static std::vector<ScanResult> scanDirectory(const std::string& scanDir, int numWorkers)
+{
+    static const std::set<std::string> validExtensions{ ".ch8", ".ch10", ".hc8", ".c8h", ".c8e", ".c8x", ".sc8", ".mc8", ".xo8" };
+    static constexpr size_t READ_BUFFER_SIZE = 1024 * 1024;
+    ScanQueue queue(1024);
+    std::vector<ScanResult> results;
+    std::mutex resultsMutex;
+    std::atomic<uint64_t> filesHashed{0};
+    std::atomic<uint64_t> bytesHashed{0};
+    std::atomic_bool done{false};
+    auto start = std::chrono::steady_clock::now();
+    std::thread walker([&]() {
+        std::error_code ec;
+        for(auto iter = fs::recursive_directory_iterator(scanDir, fs::directory_options::skip_permission_denied, ec); !ec && iter != fs::recursive_directory_iterator(); iter.increment(ec)) {
+            if(iter->is_regular_file(ec) && validExtensions.count(iter->path().extension().string())) {
+                queue.push(iter->path().string());
+            }
+        }
+        queue.close();
+    });
+    std::vector<std::thread> workers;
+    for(int i = 0; i < numWorkers; ++i) {
+        workers.emplace_back([&]() {
+            std::vector<uint8_t> buffer(READ_BUFFER_SIZE);
+            std::vector<ScanResult> local;
+            while(auto path = queue.pop()) {
+                std::ifstream is(*path, std::ios::binary);
+                if(!is)
+                    continue;
+                uint64_t size = 0;
+                auto digest = Sha1Digest::calculate(is, buffer, &size);
+                local.push_back({std::move(*path), digest});
+                ++filesHashed;
+                bytesHashed += size;
+            }
+            std::lock_guard<std::mutex> lock(resultsMutex);
+            results.insert(results.end(), std::make_move_iterator(local.begin()), std::make_move_iterator(local.end()));
+        });
+    }
+    std::thread progress([&]() {
+        auto next = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+        while(!done) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            if(std::chrono::steady_clock::now() >= next) {
+                auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                std::cerr << fmt::format("    ... {} files hashed, {:.0f} files/s", filesHashed.load(), filesHashed / seconds) << std::endl;
+                next += std::chrono::seconds(1);
+            }
+        }
+    });
+    walker.join();
+    for(auto& worker : workers) {
+        worker.join();
+    }
+    done = true;
+    progress.join();
+    auto seconds = std::max(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(), 0.000001);
+    std::cout << fmt::format("hashed {} files ({:.1f}MB) with {} workers in {:.2f}s, {:.0f} files/s, {:.1f}MB/s", filesHashed.load(), bytesHashed / 1048576.0, numWorkers, seconds, filesHashed / seconds, bytesHashed / 1048576.0 / seconds) << std::endl;
+    std::sort(results.begin(), results.end(), [](const ScanResult& a, const ScanResult& b) { return a.path < b.path; });
+    return results;
+}
 
 int main(int argc, char* argv[])
 {
@@ -78,7 +197,11 @@ int main(int argc, char* argv[])
     std::string scanDir;
     std::string infoSHA;
     std::string infoFile;
+    bool compileIndex = false;
+    cli.option({"--compile"}, compileIndex, "Compile platforms.json and programs.json into the binary index c8db.idx, that is used instead as long as it is up to date");
+    int64_t scanThreads = 0;
     cli.option({"--scan"}, scanDir, "Scan directory tree for roms, calc sha1 and report unknown ones");
+    cli.option({"--scan-threads"}, scanThreads, "Number of hashing threads used by --scan, default: one per core");
     cli.option({"-s", "--sha1"}, infoSHA, "Lookup rom SHA1 checksum (all lower-case) and give info.");
     cli.option({"-i", "--info"}, infoFile, "Lookup rom file by looking at content and give info.");
     cli.positional(files, "files to convert");
@@ -89,21 +212,44 @@ int main(int argc, char* argv[])
         exit(EXIT_FAILURE);
     }
     auto dir = fs::path(files.front());
-    if(!fs::exists(dir / "platforms.json") || !fs::exists(dir / "programs.json")) {
+    auto indexFile = dir / "c8db.idx";
+    bool hasJson = fs::exists(dir / "platforms.json") && fs::exists(dir / "programs.json");
+    if(!hasJson && (compileIndex || !fs::exists(indexFile))) {
         std::cerr << "ERROR: platforms.json and/or programs.json not found." << std::endl;
         exit(EXIT_FAILURE);
     }
-    c8db::Database db{dir.string()};
+    // the index is only used when it is not older than the json files it was compiled from
+    std::error_code ec;
+    bool useIndex = !compileIndex && fs::exists(indexFile, ec) && (!hasJson || (fs::last_write_time(indexFile, ec) >= fs::last_write_time(dir / "platforms.json", ec) && fs::last_write_time(indexFile, ec) >= fs::last_write_time(dir / "programs.json", ec)));
+    auto db = [&]() {
+        if(useIndex) {
+            try {
+                return c8db::Database::fromIndex(indexFile.string());
+            }
+            catch(const std::exception& ex) {
+                std::cerr << "WARNING: " << ex.what() << ", falling back to json files." << std::endl;
+            }
+        }
+        return c8db::Database{dir.string()};
+    }();
     if(!db.numRoms()) {
         std::cerr << "ERROR: Coeldn't load any rom info." << std::endl;
         exit(EXIT_FAILURE);
     }
+    if(compileIndex) {
+        if(!db.compile(indexFile.string())) {
+            std::cerr << "ERROR: Couldn't write " << indexFile.string() << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        std::cout << fmt::format("Compiled {} roms of {} programs into {}", db.numRoms(), db.programs().size(), indexFile.string()) << std::endl;
+        exit(EXIT_SUCCESS);
+    }
     if(!infoFile.empty()) {
         if(!fs::exists(infoFile)) {
             std::cerr << "ERROR: File doesn't exist." << std::endl;
         }
-        auto data = loadFile(infoFile);
-        infoSHA = calculateSha1(data.data(), data.size()).to_hex();
+        emu::MappedFile data(infoFile);
+        infoSHA = Sha1Digest::calculate(data.data(), data.size()).toHex();
         std::cout << "SHA1: " << infoSHA << std::endl;
     }
     if(!infoSHA.empty()) {
@@ -250,23 +396,19 @@ int main(int argc, char* argv[])
     if(!scanDir.empty()) {
         std::cout << "scanning for unknown programs..." << std::endl;
         std::set<std::string> unknowns;
-        static std::set<std::string> validExtensions{ ".ch8", ".ch10", ".hc8", ".c8h", ".c8e", ".c8x", ".sc8", ".mc8", ".xo8" };
-        for(auto& entry : fs::recursive_directory_iterator(scanDir, fs::directory_options::skip_permission_denied)) {
-            if(entry.is_regular_file() && validExtensions.count(entry.path().extension().string())) {
-                auto file = loadFile(entry.path().string());
-                auto sha1sum = calculateSha1(file.data(), file.size()).to_hex();
-                if(!lib.isKnownFile(sha1sum)) {
-                    std::cout << fmt::format("    found program unknown to Cadmium: {} - '{}'", sha1sum, entry.path().string()) << std::endl;
-                    if(dbRomMap.count(sha1sum))
-                        std::cout << fmt::format("        contained in programs.json as '{}'", dbRomMap[sha1sum]) << std::endl;
-                    else
-                        unknowns.insert(sha1sum);
-                }
-                else {
-                    const auto* romInfo = Librarian::findKnownRom(sha1sum);
-                    if(!romInfo->name || std::string(romInfo->name).empty()) {
-                        std::cout << "    found program that is known to Cadmium but has no name: " << sha1sum << " - '" << entry.path().string() << "'" << std::endl;
-                    }
+        for(const auto& [path, digest] : scanDirectory(scanDir, scanThreads > 0 ? int(scanThreads) : std::max(1, int(std::thread::hardware_concurrency())))) {
+            auto sha1sum = digest.toHex();
+            if(!lib.isKnownFile(digest)) {
+                std::cout << fmt::format("    found program unknown to Cadmium: {} - '{}'", sha1sum, path) << std::endl;
+                if(dbRomMap.count(sha1sum))
+                    std::cout << fmt::format("        contained in programs.json as '{}'", dbRomMap[sha1sum]) << std::endl;
+                else
+                    unknowns.insert(sha1sum);
+            }
+            else {
+                const auto* romInfo = Librarian::findKnownRom(digest);
+                if(romInfo && (!romInfo->name || std::string(romInfo->name).empty())) {
+                    std::cout << "    found program that is known to Cadmium but has no name: " << sha1sum << " - '" << path << "'" << std::endl;
                 }
             }
         }
@@ -0,0 +1,223 @@
+//---------------------------------------------------------------------------------------
+// tools/c8thumbs.cpp
+//---------------------------------------------------------------------------------------
+//
+// Copyright (c) 2023, Steffen Schümann <s.schuemann@pobox.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//---------------------------------------------------------------------------------------
+
+#include <c8capturehost.hpp>
+#include <chiplet/utility.hpp>
+#include <emulation/ichip8.hpp>
+#include <librarian.hpp>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <ghc/cli.hpp>
+#include <ghc/filesystem.hpp>
+#include <fmt/format.h>
+#include <raylib.h>
+
+namespace fs = ghc::filesystem;
+
+//---------------------------------------------------------------------------------------
+// Renders preview thumbnails or 3x3 sheets of the first screens for whole ROM archives.
+// Every worker runs its own headless host, no window is opened, raylib is only used to
+// encode the PNG files. Unlike the librarian previews, runs are limited by frames only,
+// so the nightly results don't depend on the load of the machine.
+//---------------------------------------------------------------------------------------
+struct ThumbnailJob
+{
+    std::string romPath;
+    std::string outputPath;  // keeps the ROM extension, the one of the format is appended
+};
+
+struct ThumbnailResult
+{
+    int width{0};
+    int height{0};
+    int frames{0};
+    double millis{0};
+    bool written{false};
+};
+
+static const std::set<std::string> g_romExtensions{".ch8", ".ch10", ".hc8", ".c8h", ".c8e", ".c8x", ".sc8", ".mc8", ".xo8", ".c8b", ".8o", ".gif"};
+
+static std::vector<ThumbnailJob> collectJobs(const std::vector<std::string>& inputs, const fs::path& outputDir)
+{
+    std::vector<ThumbnailJob> jobs;
+    for(const auto& input : inputs) {
+        std::error_code ec;
+        if(fs::is_directory(input, ec)) {
+            for(auto iter = fs::recursive_directory_iterator(input, fs::directory_options::skip_permission_denied, ec); !ec && iter != fs::recursive_directory_iterator(); iter.increment(ec)) {
+                if(iter->is_regular_file(ec) && g_romExtensions.count(iter->path().extension().string())) {
+                    auto relative = fs::relative(iter->path(), input, ec);
+                    jobs.push_back({iter->path().string(), (outputDir / relative).string()});
+                }
+            }
+        }
+        else if(fs::is_regular_file(input, ec)) {
+            jobs.push_back({input, (outputDir / fs::path(input).filename()).string()});
+        }
+        else {
+            std::cerr << "WARNING: Skipping `" << input << "`, not a file or directory." << std::endl;
+        }
+    }
+    std::sort(jobs.begin(), jobs.end(), [](const ThumbnailJob& a, const ThumbnailJob& b) { return a.romPath < b.romPath; });
+    // files of the same name given from different directories would overwrite each other
+    std::set<std::string> outputs;
+    std::vector<ThumbnailJob> unique;
+    for(auto& job : jobs) {
+        if(outputs.insert(job.outputPath).second)
+            unique.push_back(std::move(job));
+        else
+            std::cerr << "WARNING: Skipping `" << job.romPath << "`, another ROM already uses `" << job.outputPath << "`." << std::endl;
+    }
+    return unique;
+}
+
+// Pixels are RGBA in memory order, like the screens of the cores and raylib images
+static bool writeImage(const std::string& outputPath, const uint32_t* pixel, int width, int height, bool raw)
+{
+    std::error_code ec;
+    fs::create_directories(fs::path(outputPath).parent_path(), ec);
+    if(raw) {
+        return writeFile(outputPath + ".rgba", (const char*)pixel, size_t(width) * height * sizeof(uint32_t));
+    }
+    Image image{(void*)pixel, width, height, 1, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8};
+    ExportImage(image, (outputPath + ".png").c_str());
+    return fs::exists(outputPath + ".png", ec);
+}
+
+static ThumbnailResult renderThumbnail(const ThumbnailJob& job, const std::array<uint32_t, 256>& palette, int maxFrames, bool raw)
+{
+    ThumbnailResult result;
+    auto start = std::chrono::steady_clock::now();
+    auto screenshot = Librarian::renderScreenshot(job.romPath, palette, maxFrames, std::chrono::milliseconds(0));
+    result.millis = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    result.frames = maxFrames;
+    result.width = screenshot.width;
+    result.height = screenshot.height;
+    if(screenshot.width && screenshot.pixel.size() == size_t(screenshot.width) * screenshot.height)
+        result.written = writeImage(job.outputPath, screenshot.pixel.data(), screenshot.width, screenshot.height, raw);
+    return result;
+}
+
+static ThumbnailResult renderSheet(const ThumbnailJob& job, int maxFrames, bool raw)
+{
+    ThumbnailResult result;
+    C8CaptureHost host;
+    host.updateEmulatorOptions({});
+    auto start = std::chrono::steady_clock::now();
+    if(host.loadRom(job.romPath.c_str(), emu::Chip8HeadlessHost::SetToRun)) {
+        auto& chipEmu = host.chipEmu();
+        auto instructionsPerFrame = host.options().instructionsPerFrame;
+        for(result.frames = 0; result.frames < maxFrames && host.numSnapshots() < 9; ++result.frames) {
+            chipEmu.tick(instructionsPerFrame);
+        }
+        result.millis = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        result.width = C8CaptureHost::SHEET_WIDTH;
+        result.height = C8CaptureHost::SHEET_HEIGHT;
+        result.written = writeImage(job.outputPath, host.nineSnapshot().data(), result.width, result.height, raw);
+    }
+    return result;
+}
+
+int main(int argc, char* argv[])
+{
+    fs::u8arguments u8guard(argc, argv);
+    ghc::CLI cli(argc, argv);
+    std::vector<std::string> inputs;
+    std::string outputDir = "thumbnails";
+    std::string format = "png";
+    int64_t threads = 0;
+    int64_t frames = 5000;
+    bool sheets = false;
+    bool showHelp = false;
+    cli.option({"-h", "--help"}, showHelp, "Show this help text");
+    cli.option({"-o", "--output"}, outputDir, "Output directory, the structure of given directories is mirrored, default: thumbnails");
+    cli.option({"-f", "--format"}, format, "Output format, png or raw (RGBA bytes without header), default: png");
+    cli.option({"-j", "--threads"}, threads, "Number of worker threads, default: one per core");
+    cli.option({"--frames"}, frames, "Number of frames to emulate per ROM, default: 5000");
+    cli.option({"--sheet"}, sheets, "Render 3x3 sheets of the first nine screens (captured before each clear) instead of a thumbnail of the last frame");
+    cli.positional(inputs, "ROM files or directories to render");
+    cli.parse();
+    if(showHelp) {
+        cli.usage();
+        exit(0);
+    }
+    if(inputs.empty()) {
+        std::cerr << "ERROR: No ROM files or directories given." << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    if(format != "png" && format != "raw") {
+        std::cerr << "ERROR: Unknown output format `" << format << "`, use png or raw." << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    SetTraceLogLevel(LOG_WARNING);
+    auto jobs = collectJobs(inputs, outputDir);
+    auto numWorkers = int(threads > 0 ? threads : std::max(1u, std::thread::hardware_concurrency()));
+    numWorkers = std::min(numWorkers, std::max(1, int(jobs.size())));
+    bool raw = format == "raw";
+    std::array<uint32_t, 256> palette{};
+    {
+        emu::Chip8HeadlessHost host;
+        palette = host.defaultPalette();
+    }
+    std::vector<ThumbnailResult> results(jobs.size());
+    std::atomic<size_t> nextJob{0};
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for(int i = 0; i < numWorkers; ++i) {
+        workers.emplace_back([&]() {
+            for(auto job = nextJob++; job < jobs.size(); job = nextJob++) {
+                results[job] = sheets ? renderSheet(jobs[job], int(frames), raw) : renderThumbnail(jobs[job], palette, int(frames), raw);
+            }
+        });
+    }
+    for(auto& worker : workers) {
+        worker.join();
+    }
+    auto seconds = std::max(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(), 0.000001);
+    size_t written = 0;
+    double emulationMillis = 0;
+    for(size_t i = 0; i < jobs.size(); ++i) {
+        const auto& result = results[i];
+        if(result.written) {
+            ++written;
+            std::cout << fmt::format("{:9.2f}ms {:5} frames {:3}x{:<3} {}", result.millis, result.frames, result.width, result.height, jobs[i].romPath) << std::endl;
+        }
+        else {
+            std::cout << fmt::format("{:9.2f}ms {:>5} frames         {} (no image)", result.millis, "-", jobs[i].romPath) << std::endl;
+        }
+        emulationMillis += result.millis;
+    }
+    std::cout << fmt::format("rendered {} of {} roms with {} workers in {:.2f}s, {:.1f} roms/s, {:.2f}ms average emulation time", written, jobs.size(), numWorkers, seconds, jobs.size() / seconds, jobs.empty() ? 0.0 : emulationMillis / jobs.size()) << std::endl;
+    return written == jobs.size() ? EXIT_SUCCESS : EXIT_FAILURE;
+}